@@ -2,6 +2,11 @@
 
 #include "bitboard.hpp"
 #include "magic.hpp"
+#include "pext.hpp"
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
 
 inline constexpr Sides::Array<Squares::Array<Bitboard>> pawn_attacks = []() {
   Sides::Array<Squares::Array<Bitboard>> attacks;
@@ -68,17 +73,38 @@ constexpr Bitboard attacks_bb<Pieces::KING>(Square square, Bitboard) {
   return pseudoattacks[square];
 }
 
+template <Piece::Literal P>
+constexpr Bitboard magic_attacks(Square square, Bitboard occupied) {
+  constexpr int shift = 64 - (P == Pieces::BISHOP ? 9 : 12);
+
+  auto [attacks, mask, hash] = magics<P>[square];
+  return attacks[((occupied.raw() | mask) * hash) >> shift];
+}
+
+// Sliders use the PEXT tables when built with USE_PEXT (make SLIDERS=pext or
+// SLIDERS=pdep) and black magics otherwise. Constant evaluation always takes
+// the magic path
 template <>
 constexpr Bitboard attacks_bb<Pieces::BISHOP>(Square square,
                                               Bitboard occupied) {
-  auto [attacks, mask, hash] = magics<Pieces::BISHOP>[square];
-  return attacks[((occupied.raw() | mask) * hash) >> (64 - 9)];
+#ifdef USE_PEXT
+  if !consteval {
+    return pext_attacks<Pieces::BISHOP>(square, occupied);
+  }
+#endif
+
+  return magic_attacks<Pieces::BISHOP>(square, occupied);
 }
 
 template <>
 constexpr Bitboard attacks_bb<Pieces::ROOK>(Square square, Bitboard occupied) {
-  auto [attacks, mask, hash] = magics<Pieces::ROOK>[square];
-  return attacks[((occupied.raw() | mask) * hash) >> (64 - 12)];
+#ifdef USE_PEXT
+  if !consteval {
+    return pext_attacks<Pieces::ROOK>(square, occupied);
+  }
+#endif
+
+  return magic_attacks<Pieces::ROOK>(square, occupied);
 }
 
 template <>
@@ -103,3 +129,135 @@ constexpr Bitboard attacks_bb(Piece p, Square square, Bitboard occupied) {
     return 0;
   }
 }
+
+#ifdef __AVX2__
+// Kogge-Stone occluded fills of every slider at once. One register holds the
+// rays going up (N, E, NE, NW) and shifts left, the other the rays going down
+// (S, W, SW, SE) and shifts right, each lane by its own direction's amount.
+// The wrap masks keep east and west rays from crossing the board edge
+inline Bitboard kogge_stone_attacks(Bitboard orth, Bitboard diag,
+                                    Bitboard occupied) {
+  const uint64_t not_a = ~Bitboards::FileA.raw(),
+                 not_h = ~Bitboards::FileH.raw();
+  const __m256i shift = _mm256_setr_epi64x(8, 1, 9, 7),
+                shift2 = _mm256_add_epi64(shift, shift),
+                shift4 = _mm256_add_epi64(shift2, shift2),
+                empty = _mm256_set1_epi64x(~occupied.raw()),
+                generators = _mm256_setr_epi64x(orth.raw(), orth.raw(),
+                                                diag.raw(), diag.raw()),
+                up_wrap = _mm256_setr_epi64x(-1, not_a, not_a, not_h),
+                down_wrap = _mm256_setr_epi64x(-1, not_h, not_h, not_a);
+
+  __m256i up = generators,
+          up_propagators = _mm256_and_si256(empty, up_wrap), down = generators,
+          down_propagators = _mm256_and_si256(empty, down_wrap);
+
+  for (__m256i s : {shift, shift2, shift4}) {
+    up = _mm256_or_si256(
+        up, _mm256_and_si256(up_propagators, _mm256_sllv_epi64(up, s)));
+    up_propagators = _mm256_and_si256(up_propagators,
+                                      _mm256_sllv_epi64(up_propagators, s));
+    down = _mm256_or_si256(
+        down, _mm256_and_si256(down_propagators, _mm256_srlv_epi64(down, s)));
+    down_propagators = _mm256_and_si256(
+        down_propagators, _mm256_srlv_epi64(down_propagators, s));
+  }
+
+  __m256i attacks = _mm256_or_si256(
+      _mm256_and_si256(_mm256_sllv_epi64(up, shift), up_wrap),
+      _mm256_and_si256(_mm256_srlv_epi64(down, shift), down_wrap));
+  __m128i half = _mm_or_si128(_mm256_castsi256_si128(attacks),
+                              _mm256_extracti128_si256(attacks, 1));
+
+  return _mm_cvtsi128_si64(_mm_or_si128(half, _mm_unpackhi_epi64(half, half)));
+}
+#endif
+
+// Squares attacked by the rooks and queens in orth and the bishops and queens
+// in diag. Set-wise with AVX2, one lookup per piece otherwise
+constexpr Bitboard slider_attacks(Bitboard orth, Bitboard diag,
+                                  Bitboard occupied) {
+#ifdef __AVX2__
+  if !consteval {
+    return kogge_stone_attacks(orth, diag, occupied);
+  }
+#endif
+
+  Bitboard attacks;
+
+  while (orth)
+    attacks |= attacks_bb<Pieces::ROOK>(orth.pop_lsb(), occupied);
+
+  while (diag)
+    attacks |= attacks_bb<Pieces::BISHOP>(diag.pop_lsb(), occupied);
+
+  return attacks;
+}
+
+constexpr Bitboard knight_attacks(Bitboard knights) {
+  Bitboard one = knights.shift<Direction::WEST>() |
+                 knights.shift<Direction::EAST>(),
+           two = knights.shift<Direction::WEST>().shift<Direction::WEST>() |
+                 knights.shift<Direction::EAST>().shift<Direction::EAST>();
+
+  return (one << 16) | (one >> 16) | (two << 8) | (two >> 8);
+}
+
+constexpr Bitboard pawn_attacks_bb(Side side, Bitboard pawns) {
+  return side == Sides::WHITE ? pawns.shift<Direction::NORTH_WEST>() |
+                                    pawns.shift<Direction::NORTH_EAST>()
+                              : pawns.shift<Direction::SOUTH_WEST>() |
+                                    pawns.shift<Direction::SOUTH_EAST>();
+}
+
+// Squares strictly between two squares sharing a rank, file or diagonal, empty
+// for any other pair
+inline constexpr Squares::Array<Squares::Array<Bitboard>> between_bb = []() {
+  Squares::Array<Squares::Array<Bitboard>> between;
+
+  for (Square from : Squares::ALL)
+    for (Square to : Squares::ALL) {
+      int rank_delta = to.rank() - from.rank(),
+          file_delta = to.file() - from.file();
+
+      if (from == to || (rank_delta && file_delta &&
+                         rank_delta * rank_delta != file_delta * file_delta))
+        continue;
+
+      int rank_step = (rank_delta > 0) - (rank_delta < 0),
+          file_step = (file_delta > 0) - (file_delta < 0);
+
+      for (int rank = from.rank() + rank_step, file = from.file() + file_step;
+           Square(rank, file) != to; rank += rank_step, file += file_step)
+        between[from][to] |= Bitboard(rank, file);
+    }
+
+  return between;
+}();
+
+// The whole rank, file or diagonal through two squares, empty if they share
+// none
+inline constexpr Squares::Array<Squares::Array<Bitboard>> line_bb = []() {
+  Squares::Array<Squares::Array<Bitboard>> line;
+
+  for (Square from : Squares::ALL)
+    for (Square to : Squares::ALL) {
+      int rank_delta = to.rank() - from.rank(),
+          file_delta = to.file() - from.file();
+
+      if (from == to || (rank_delta && file_delta &&
+                         rank_delta * rank_delta != file_delta * file_delta))
+        continue;
+
+      int rank_step = (rank_delta > 0) - (rank_delta < 0),
+          file_step = (file_delta > 0) - (file_delta < 0);
+
+      for (int sign : {-1, 1})
+        for (int rank = from.rank(), file = from.file();
+             rank >= 0 && rank < 8 && file >= 0 && file < 8;
+             rank += sign * rank_step, file += sign * file_step)
+          line[from][to] |= Bitboard(rank, file);
+    }
+
+  return line;
+}();
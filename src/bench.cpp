@@ -0,0 +1,217 @@
+#include "bench.hpp"
+#include <random>
+#include <thread>
+
+void bench(Searcher &searcher, int depth, const PerspectiveNetwork &net) {
+  std::println("info string simd {}", Simd::level_name(Simd::level));
+
+  int64_t total_nodes = 0;
+  auto start = std::chrono::system_clock::now();
+
+  for (std::string_view fen : BENCH_FENS) {
+    searcher.clear();
+    searcher.search<false>(NetBoard(fen, net), std::nullopt, std::nullopt,
+                           std::nullopt, depth);
+    total_nodes += searcher.nodes();
+  }
+
+  auto time_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+                     std::chrono::system_clock::now() - start)
+                     .count();
+
+  std::println("{} nodes {} nps {} ms", total_nodes,
+               1000 * total_nodes / (time_ms + 1), time_ms);
+}
+
+void slider_bench(int64_t lookups) {
+  std::mt19937_64 rng(0);
+  std::vector<std::pair<Square, Bitboard>> queries(1 << 16);
+
+  // Three random words anded together fill about an eighth of the board
+  for (auto &[square, occupied] : queries) {
+    square = Square(static_cast<int>(rng() % 64));
+    occupied = rng() & rng() & rng();
+  }
+
+  auto run = [&](std::string_view name, auto attacks) {
+    int64_t errors = 0;
+
+    for (auto [square, occupied] : queries)
+      errors +=
+          attacks(square, occupied).raw() !=
+          (sliding_attacks(Pieces::BISHOP, square, occupied) |
+           sliding_attacks(Pieces::ROOK, square, occupied))
+              .raw();
+
+    uint64_t checksum = 0;
+    auto start = std::chrono::steady_clock::now();
+
+    for (int64_t i = 0; i < lookups; ++i) {
+      auto [square, occupied] = queries[i & (queries.size() - 1)];
+      checksum ^= attacks(square, occupied).raw();
+    }
+
+    auto time_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                       std::chrono::steady_clock::now() - start)
+                       .count();
+
+    std::println("{}: {:.2f} ns per lookup, {} errors, checksum {:#x}", name,
+                 static_cast<double>(time_ns) / lookups, errors, checksum);
+  };
+
+  run("magic", [](Square square, Bitboard occupied) {
+    return magic_attacks<Pieces::BISHOP>(square, occupied) |
+           magic_attacks<Pieces::ROOK>(square, occupied);
+  });
+
+#ifdef USE_PEXT
+  auto pext_lookup = [](Square square, Bitboard occupied) {
+    return pext_attacks<Pieces::BISHOP>(square, occupied) |
+           pext_attacks<Pieces::ROOK>(square, occupied);
+  };
+
+#ifdef USE_PDEP
+  run("pdep", pext_lookup);
+#else
+  run("pext", pext_lookup);
+#endif
+#endif
+}
+
+void simd_check(const PerspectiveNetwork &net, int playouts) {
+  static constexpr std::array LEVELS{Simd::Level::AVX2, Simd::Level::AVX512};
+
+  std::mt19937_64 rng(0);
+  int64_t positions = 0;
+  std::array<int64_t, LEVELS.size()> mismatches{};
+
+  auto check = [&](NetBoard &board) {
+    const Sides::Array<Accumulator> &acc = board.current_accumulators();
+    ++positions;
+
+    for (Side perspective : Sides::ALL)
+      for (const Accumulator &weights : net.output_weights) {
+        const int16_t *input = acc[perspective].state.data(),
+                      *row = weights.state.data();
+        int expected = Simd::crelu_dot<HL>(input, row, QA, Simd::Level::SCALAR);
+
+        for (std::size_t i = 0; i < LEVELS.size(); ++i)
+          if (Simd::supported(LEVELS[i]))
+            mismatches[i] +=
+                Simd::crelu_dot<HL>(input, row, QA, LEVELS[i]) != expected;
+      }
+  };
+
+  for (std::string_view fen : BENCH_FENS)
+    for (int playout = 0; playout < playouts; ++playout) {
+      NetBoard board(fen, net);
+      check(board);
+
+      for (int ply = 0; ply < 200; ++ply) {
+        MoveList moves = board.legal_moves();
+
+        if (moves.size() == 0)
+          break;
+
+        board.make_move(moves[rng() % moves.size()]);
+        check(board);
+      }
+    }
+
+  for (std::size_t i = 0; i < LEVELS.size(); ++i)
+    if (Simd::supported(LEVELS[i]))
+      std::println("{}: {} positions, {} mismatches",
+                   Simd::level_name(LEVELS[i]), positions, mismatches[i]);
+    else
+      std::println("{}: not supported", Simd::level_name(LEVELS[i]));
+}
+
+void tt_stress(int num_threads, int64_t iterations) {
+  // A single cluster shared by more keys than it has slots, so different
+  // keys keep overwriting each other's entries. The low 16 bits are distinct
+  // so that an entry written whole never verifies against another key
+  std::mt19937_64 rng(0);
+  std::vector<uint64_t> keys(64);
+
+  for (std::size_t i = 0; i < keys.size(); ++i)
+    keys[i] = (rng() & ~uint64_t(0xFFFF)) | i;
+
+  // Never a null move, which insert would replace with the one stored before
+  auto stored = [](uint64_t key, int writer) {
+    uint64_t mixed = (key ^ writer) * 0x9E3779B97F4A7C15;
+    Move move;
+    move.data = (mixed >> 48) | 1;
+
+    return TTNode{move, static_cast<short>(mixed >> 32),
+                  static_cast<short>(mixed >> 16),
+                  static_cast<short>((mixed >> 8) & 0x3F),
+                  static_cast<TTNode::Type>(mixed % 3)};
+  };
+
+  auto run = [&]<typename Table>(std::string_view name, Table &ttable) {
+    ttable.resize(0);
+    ttable.allocate(1);
+
+    std::atomic<int64_t> hits = 0, corrupt = 0;
+    auto start = std::chrono::steady_clock::now();
+
+    {
+      std::vector<std::jthread> threads;
+
+      for (int writer = 0; writer < num_threads; ++writer)
+        threads.emplace_back([&, writer]() {
+          std::mt19937_64 rng(writer + 1);
+          int64_t local_hits = 0, local_corrupt = 0;
+
+          for (int64_t i = 0; i < iterations; ++i) {
+            uint64_t key = keys[rng() % keys.size()];
+
+            if (i % 2 == 0) {
+              TTNode node = stored(key, writer);
+              ttable.insert(key, node.best_move, node.value, node.static_eval,
+                            node.depth, node.type, 0);
+              continue;
+            }
+
+            std::optional<TTNode> node = ttable.lookup(key, 0);
+
+            if (!node)
+              continue;
+
+            ++local_hits;
+            local_corrupt += std::ranges::none_of(
+                std::views::iota(0, num_threads), [&](int other) {
+                  TTNode expected = stored(key, other);
+
+                  return node->best_move == expected.best_move &&
+                         node->value == expected.value &&
+                         node->static_eval == expected.static_eval &&
+                         node->depth == expected.depth &&
+                         node->type == expected.type;
+                });
+          }
+
+          hits += local_hits;
+          corrupt += local_corrupt;
+        });
+    }
+
+    auto time_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+                       std::chrono::steady_clock::now() - start)
+                       .count();
+
+    std::println("{}: {} threads, {} hits, {} corrupt, {} ms", name,
+                 num_threads, hits.load(), corrupt.load(), time_ms);
+  };
+
+  // The interleaved runs force half-written entries however many cores there
+  // are, and the control one stores the keys without the fold, so those
+  // entries show up as corrupt hits instead of misses
+  TTable plain;
+  BasicTTable<true, true> interleaved;
+  BasicTTable<false, true> control;
+
+  run("plain", plain);
+  run("interleaved", interleaved);
+  run("interleaved, unverified", control);
+}
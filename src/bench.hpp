@@ -0,0 +1,40 @@
+#pragma once
+
+#include "searcher.hpp"
+
+inline constexpr std::array<std::string_view, 16> BENCH_FENS{
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+    "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+    "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+    "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+    "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+    "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+    "r1bqkbnr/pppp1ppp/2n5/4p3/4P3/5N2/PPPP1PPP/RNBQKB1R w KQkq - 2 3",
+    "r1bq1rk1/pp2bppp/2n1pn2/2pp4/3P4/2PBPN2/PP1N1PPP/R1BQ1RK1 w - - 0 8",
+    "2r3k1/pp3ppp/2n1b3/3pP3/3P4/2PB4/P4PPP/R4RK1 b - - 0 20",
+    "r1b2rk1/2q1bppp/p2ppn2/1p6/3QP3/1BN1B3/PPP2PPP/3RR1K1 w - - 0 14",
+    "4rrk1/pp1n3p/3q2pQ/2p1pb2/2PP4/2P3N1/P2B2PP/4RRK1 b - - 7 19",
+    "6k1/5ppp/8/8/8/8/5PPP/3R2K1 w - - 0 1",
+    "8/8/4k3/8/2p5/8/B2P2K1/8 w - - 0 1",
+    "8/k7/3p4/p2P1p2/P2P1P2/8/8/K7 w - - 0 1",
+    "1k6/1b6/8/8/7R/8/8/4K2R b K - 0 1",
+    "3r2k1/1p3ppp/2pq4/p1n5/P6P/1P6/1PB2QP1/1K2R3 w - - 0 1",
+};
+
+void bench(Searcher &searcher, int depth, const PerspectiveNetwork &net);
+
+// Times bishop plus rook lookups on random occupancies for every slider
+// backend compiled in, after checking each one against sliding_attacks
+void slider_bench(int64_t lookups);
+
+// Compares the vectorised output layer against the scalar one for every SIMD
+// level the CPU supports, on the bench positions and random playouts from
+// each of them
+void simd_check(const PerspectiveNetwork &net, int playouts);
+
+// Inserts and looks up a small shared set of keys in a single cluster from
+// num_threads threads, each writer storing its own fields for every key, and
+// counts the hits that do not match what any writer stored. Runs the real
+// table, then one forced to interleave the stores of different threads, then
+// the same without key verification as a control
+void tt_stress(int num_threads, int64_t iterations);
@@ -10,23 +10,71 @@
 #include <functional>
 #include <ranges>
 
+namespace Castling {
+// Bit of the castling mask for one right, i = 0 for the king side
+constexpr uint8_t right(Side side, int i) {
+  return 1 << (2 * (side == Sides::BLACK) + i);
+}
+
+inline constexpr uint8_t ALL = 0b1111;
+
+// Rights lost when a move starts or ends on a square, i.e. when the king or
+// a rook leaves its home square or a rook is captured on it
+inline constexpr Squares::Array<uint8_t> lost_on = []() {
+  Squares::Array<uint8_t> lost{};
+
+  lost[Squares::E1] = right(Sides::WHITE, 0) | right(Sides::WHITE, 1);
+  lost[Squares::H1] = right(Sides::WHITE, 0);
+  lost[Squares::A1] = right(Sides::WHITE, 1);
+  lost[Squares::E8] = right(Sides::BLACK, 0) | right(Sides::BLACK, 1);
+  lost[Squares::H8] = right(Sides::BLACK, 0);
+  lost[Squares::A8] = right(Sides::BLACK, 1);
+
+  return lost;
+}();
+} // namespace Castling
+
+// Which slice of the pseudolegal moves a generator produces
+enum class GenType { NOISY, QUIET, EVASIONS };
+
 struct Board {
-  Sides::Array<Pieces::Array<Bitboard>> pieces;
+  // The state make_move overwrites and unmake_move cannot derive from the
+  // move itself
+  struct Undo {
+    uint64_t zobrist;
+    Sides::Array<Bitboard> attacked;
+    Sides::Array<bool> attacks_known;
+    Bitboard checkers;
+    Square ep_square;
+    uint8_t castling_rights, halfmove_clock;
+    Piece captured;
+  };
+
+  // A piece's squares are the intersection of its type's and its side's
+  // bitboards. Mailbox entries hold the piece in the low three bits and the
+  // side above them
+  Pieces::Array<Bitboard> piece_occupancy;
   Sides::Array<Bitboard> side_occupancy;
-  Squares::Array<Piece> square_to_piece;
-  Bitboard general_occupancy;
-  int halfmove_clock;
+  Squares::Array<uint8_t> mailbox;
+  // The enemy pieces checking the side to move, found by every make_move, and
+  // the squares each side attacks, which attacks() builds on first use after
+  // a move since most nodes are cut off before generating king moves
+  mutable Sides::Array<Bitboard> attacked;
+  mutable Sides::Array<bool> attacks_known;
+  Bitboard checkers;
+  uint64_t zobrist;
   Square ep_square;
   Side stm;
-  Sides::Array<std::array<bool, 2>> castling_rights;
-  uint64_t zobrist;
+  uint8_t castling_rights, halfmove_clock;
 
   constexpr Board() = default;
 
   constexpr Board(std::string_view fen_string)
-      : pieces{}, side_occupancy{}, square_to_piece{}, zobrist{0} {
+      : piece_occupancy{}, side_occupancy{}, zobrist{0} {
     std::vector<std::string_view> tokens = string_tokenizer(fen_string);
 
+    mailbox.fill(to_mailbox(Sides::WHITE, Pieces::NONE));
+
     int rank = 7, file = 0;
 
     for (char c : tokens[0])
@@ -36,105 +84,149 @@ struct Board {
       } else if (isdigit(c))
         file += c - '0';
       else {
+        Side side = isupper(c) ? Sides::WHITE : Sides::BLACK;
         Piece piece(c);
 
-        pieces[isupper(c) ? Sides::WHITE : Sides::BLACK][piece] |=
-            Bitboard(rank, file);
-        square_to_piece[Square(rank, file)] = piece;
+        piece_occupancy[piece] |= Bitboard(rank, file);
+        side_occupancy[side] |= Bitboard(rank, file);
+        mailbox[Square(rank, file)] = to_mailbox(side, piece);
 
         ++file;
       }
 
-    for (Side side : Sides::ALL)
-      for (Piece piece : Pieces::ALL)
-        side_occupancy[side] |= pieces[side][piece];
-
-    general_occupancy =
-        side_occupancy[Sides::WHITE] | side_occupancy[Sides::BLACK];
     stm = tokens[1] == "w" ? Sides::WHITE : Sides::BLACK;
-    castling_rights[Sides::WHITE][0] = tokens[2].contains('K');
-    castling_rights[Sides::WHITE][1] = tokens[2].contains('Q');
-    castling_rights[Sides::BLACK][0] = tokens[2].contains('k');
-    castling_rights[Sides::BLACK][1] = tokens[2].contains('q');
+    castling_rights = 0;
+
+    // "KQkq" lists the rights in mask bit order
+    for (auto [bit, c] : std::views::enumerate(std::string_view("KQkq")))
+      if (tokens[2].contains(c))
+        castling_rights |= 1 << bit;
     ep_square = Square(tokens[3]);
     std::from_chars(tokens[4].begin(), tokens[4].end(), halfmove_clock);
     zobrist = hash();
+
+    if (stm == Sides::WHITE)
+      update_attacks<Sides::WHITE>();
+    else
+      update_attacks<Sides::BLACK>();
+  }
+
+  static constexpr uint8_t to_mailbox(Side side, Piece piece) {
+    return piece.raw() | (side == Sides::BLACK) << 3;
+  }
+
+  constexpr Piece piece_on(Square square) const {
+    return static_cast<Piece::Literal>(mailbox[square] & 0b111);
+  }
+
+  // Only meaningful for occupied squares
+  constexpr Side side_on(Square square) const {
+    return static_cast<Side::Literal>(mailbox[square] >> 3);
+  }
+
+  constexpr Bitboard pieces(Side side, Piece piece) const {
+    return piece_occupancy[piece] & side_occupancy[side];
+  }
+
+  constexpr Bitboard general_occupancy() const {
+    return side_occupancy[Sides::WHITE] | side_occupancy[Sides::BLACK];
+  }
+
+  constexpr bool can_castle(Side side, int i) const {
+    return castling_rights & Castling::right(side, i);
   }
 
-  constexpr virtual void add_piece(Side side, Piece piece, Square square) {
-    pieces[side][piece] |= Bitboard(square);
-    square_to_piece[square] = piece;
-    zobrist ^= Zobrist::square_rands[square][piece][side];
+  template <Side::Literal SIDE>
+  constexpr void add_piece(Piece piece, Square square) {
+    piece_occupancy[piece] |= Bitboard(square);
+    side_occupancy[SIDE] |= Bitboard(square);
+    mailbox[square] = to_mailbox(SIDE, piece);
+    zobrist ^= Zobrist::square_rands[square][piece][SIDE];
   }
 
-  constexpr virtual void remove_piece(Side side, Piece piece, Square square) {
-    pieces[side][piece] &= ~Bitboard(square);
-    square_to_piece[square] = Pieces::NONE;
-    zobrist ^= Zobrist::square_rands[square][piece][side];
+  template <Side::Literal SIDE>
+  constexpr void remove_piece(Piece piece, Square square) {
+    piece_occupancy[piece] &= ~Bitboard(square);
+    side_occupancy[SIDE] &= ~Bitboard(square);
+    mailbox[square] = to_mailbox(Sides::WHITE, Pieces::NONE);
+    zobrist ^= Zobrist::square_rands[square][piece][SIDE];
   }
 
-  constexpr virtual void move_piece(Side side, Piece piece, Square from,
-                                    Square to) {
-    pieces[side][piece] ^= Bitboard(from) | Bitboard(to);
-    square_to_piece[from] = Pieces::NONE;
-    square_to_piece[to] = piece;
-    zobrist ^= Zobrist::square_rands[from][piece][side] ^
-               Zobrist::square_rands[to][piece][side];
+  template <Side::Literal SIDE>
+  constexpr void move_piece(Piece piece, Square from, Square to) {
+    Bitboard from_to = Bitboard(from) | Bitboard(to);
+
+    piece_occupancy[piece] ^= from_to;
+    side_occupancy[SIDE] ^= from_to;
+    mailbox[to] = mailbox[from];
+    mailbox[from] = to_mailbox(Sides::WHITE, Pieces::NONE);
+    zobrist ^= Zobrist::square_rands[from][piece][SIDE] ^
+               Zobrist::square_rands[to][piece][SIDE];
   }
 
-  constexpr void make_move(Move m) {
-    Piece moved_piece = square_to_piece[m.from()];
+  // Zobrist key of the position after m, ignoring castling rights and the
+  // new en passant square. Only meant for prefetching TT entries
+  constexpr uint64_t key_after(Move m) const {
+    Piece moved_piece = piece_on(m.from());
+    uint64_t key = zobrist ^ Zobrist::stm_rand ^
+                   Zobrist::square_rands[m.from()][moved_piece][stm] ^
+                   Zobrist::square_rands[m.to()][m.is_promotion()
+                                                     ? m.promoted_to()
+                                                     : moved_piece][stm];
 
     if (m.is_en_passant())
-      remove_piece(~stm, Pieces::PAWN,
-                   ep_square.shift(stm == Sides::WHITE ? Direction::SOUTH
-                                                       : Direction::NORTH));
+      key ^= Zobrist::square_rands[ep_square.shift(
+          stm == Sides::WHITE ? Direction::SOUTH : Direction::NORTH)]
+                                  [Pieces::PAWN][~stm];
     else if (m.is_capture())
-      remove_piece(~stm, square_to_piece[m.to()], m.to());
+      key ^= Zobrist::square_rands[m.to()][piece_on(m.to())][~stm];
 
-    move_piece(stm, moved_piece, m.from(), m.to());
+    if (ep_square != Squares::NONE)
+      key ^= Zobrist::ep_rands[ep_square.file()];
 
-    if (moved_piece == Pieces::KING)
-      for (int i = 0; i < 2; ++i)
-        if (castling_rights[stm][i]) {
-          castling_rights[stm][i] = false;
-          zobrist ^= Zobrist::castling_rands[stm][i];
-        }
+    return key;
+  }
 
-    if (castling_rights[Sides::WHITE][0] &&
-        (m.from() == Squares::H1 || m.to() == Squares::H1)) {
-      castling_rights[Sides::WHITE][0] = false;
-      zobrist ^= Zobrist::castling_rands[Sides::WHITE][0];
-    } else if (castling_rights[Sides::WHITE][1] &&
-               (m.from() == Squares::A1 || m.to() == Squares::A1)) {
-      castling_rights[Sides::WHITE][1] = false;
-      zobrist ^= Zobrist::castling_rands[Sides::WHITE][1];
-    }
+  // Piece updates go through Self, so a derived board that hides add_piece,
+  // remove_piece and move_piece gets its own versions inlined without any
+  // virtual dispatch. STM must be the side to move
+  template <Side::Literal STM, typename Self = Board>
+  constexpr Undo make_move(Move m) {
+    constexpr Direction down =
+        STM == Sides::WHITE ? Direction::SOUTH : Direction::NORTH;
+    constexpr int castling_rank = STM == Sides::WHITE ? 0 : 7;
+
+    Self &self = static_cast<Self &>(*this);
+    Piece moved_piece = piece_on(m.from());
+    Undo undo{zobrist, attacked, attacks_known, checkers, ep_square,
+              castling_rights, halfmove_clock,
+              m.is_en_passant() ? Piece(Pieces::PAWN) : piece_on(m.to())};
 
-    if (castling_rights[Sides::BLACK][0] &&
-        (m.from() == Squares::H8 || m.to() == Squares::H8)) {
-      castling_rights[Sides::BLACK][0] = false;
-      zobrist ^= Zobrist::castling_rands[Sides::BLACK][0];
-    } else if (castling_rights[Sides::BLACK][1] &&
-               (m.from() == Squares::A8 || m.to() == Squares::A8)) {
-      castling_rights[Sides::BLACK][1] = false;
-      zobrist ^= Zobrist::castling_rands[Sides::BLACK][1];
-    }
+    if (m.is_en_passant())
+      self.template remove_piece<~STM>(Pieces::PAWN,
+                                       ep_square.shift<down>());
+    else if (m.is_capture())
+      self.template remove_piece<~STM>(piece_on(m.to()), m.to());
+
+    self.template move_piece<STM>(moved_piece, m.from(), m.to());
+
+    zobrist ^= Zobrist::castling_rands[castling_rights];
+    castling_rights &=
+        ~(Castling::lost_on[m.from()] | Castling::lost_on[m.to()]);
+    zobrist ^= Zobrist::castling_rands[castling_rights];
 
     if (m.is_promotion()) {
-      remove_piece(stm, Pieces::PAWN, m.to());
-      add_piece(stm, m.promoted_to(), m.to());
+      self.template remove_piece<STM>(Pieces::PAWN, m.to());
+      self.template add_piece<STM>(m.promoted_to(), m.to());
     }
 
     if (m.is_castle()) {
-      if (m.to() == Squares::G1)
-        move_piece(stm, Pieces::ROOK, Squares::H1, Squares::F1);
-      else if (m.to() == Squares::C1)
-        move_piece(stm, Pieces::ROOK, Squares::A1, Squares::D1);
-      else if (m.to() == Squares::G8)
-        move_piece(stm, Pieces::ROOK, Squares::H8, Squares::F8);
-      else if (m.to() == Squares::C8)
-        move_piece(stm, Pieces::ROOK, Squares::A8, Squares::D8);
+      if (m.to().file() == 6)
+        self.template move_piece<STM>(Pieces::ROOK, Square(castling_rank, 7),
+                                      Square(castling_rank, 5));
+      else
+        self.template move_piece<STM>(Pieces::ROOK, Square(castling_rank, 0),
+                                      Square(castling_rank, 3));
     }
 
     if (ep_square != Squares::NONE)
@@ -143,30 +235,85 @@ struct Board {
     ep_square = Squares::NONE;
 
     if (m.is_double_push()) {
-      Square ep_square_candidate = m.to().shift(
-          stm == Sides::WHITE ? Direction::SOUTH : Direction::NORTH);
+      Square ep_square_candidate = m.to().shift<down>();
 
-      if (pieces[~stm][Pieces::PAWN] & pawn_attacks[stm][ep_square_candidate]) {
+      if (pieces(~STM, Pieces::PAWN) & pawn_attacks[STM][ep_square_candidate]) {
         ep_square = ep_square_candidate;
         zobrist ^= Zobrist::ep_rands[ep_square.file()];
       }
     }
 
-    side_occupancy = {};
-
-    for (Side side : Sides::ALL)
-      for (Piece piece : Pieces::ALL)
-        side_occupancy[side] |= pieces[side][piece];
-
-    general_occupancy =
-        side_occupancy[Sides::WHITE] | side_occupancy[Sides::BLACK];
     halfmove_clock =
         moved_piece == Pieces::PAWN || m.is_capture() ? 0 : halfmove_clock + 1;
-    stm = ~stm;
+    stm = ~STM;
     zobrist ^= Zobrist::stm_rand;
+    update_attacks<~STM>();
+
+    return undo;
+  }
+
+  template <typename Self = Board> constexpr Undo make_move(Move m) {
+    return stm == Sides::WHITE ? make_move<Sides::WHITE, Self>(m)
+                               : make_move<Sides::BLACK, Self>(m);
+  }
+
+  // Takes back m, which must be the last move made and must have been played
+  // by STM. Only Board's own piece helpers are used, so derived boards have to
+  // restore their state themselves
+  template <Side::Literal STM>
+  constexpr void unmake_move(Move m, const Undo &undo) {
+    constexpr Direction down =
+        STM == Sides::WHITE ? Direction::SOUTH : Direction::NORTH;
+    constexpr int castling_rank = STM == Sides::WHITE ? 0 : 7;
+
+    stm = STM;
+
+    Piece moved_piece = piece_on(m.to());
+
+    if (m.is_promotion()) {
+      remove_piece<STM>(moved_piece, m.to());
+      add_piece<STM>(Pieces::PAWN, m.to());
+      moved_piece = Pieces::PAWN;
+    }
+
+    if (m.is_castle()) {
+      if (m.to().file() == 6)
+        move_piece<STM>(Pieces::ROOK, Square(castling_rank, 5),
+                        Square(castling_rank, 7));
+      else
+        move_piece<STM>(Pieces::ROOK, Square(castling_rank, 3),
+                        Square(castling_rank, 0));
+    }
+
+    move_piece<STM>(moved_piece, m.to(), m.from());
+
+    if (m.is_en_passant())
+      add_piece<~STM>(Pieces::PAWN, undo.ep_square.shift<down>());
+    else if (m.is_capture())
+      add_piece<~STM>(undo.captured, m.to());
+
+    zobrist = undo.zobrist;
+    attacked = undo.attacked;
+    attacks_known = undo.attacks_known;
+    checkers = undo.checkers;
+    halfmove_clock = undo.halfmove_clock;
+    ep_square = undo.ep_square;
+    castling_rights = undo.castling_rights;
+  }
+
+  constexpr void unmake_move(Move m, const Undo &undo) {
+    if (stm == Sides::WHITE)
+      unmake_move<Sides::BLACK>(m, undo);
+    else
+      unmake_move<Sides::WHITE>(m, undo);
   }
 
-  constexpr void make_null_move() {
+  constexpr Undo make_null_move() {
+    assert(!checkers);
+
+    Undo undo{zobrist, attacked, attacks_known, checkers, ep_square,
+              castling_rights, halfmove_clock, Pieces::NONE};
+
     if (ep_square != Squares::NONE)
       zobrist ^= Zobrist::ep_rands[ep_square.file()];
 
@@ -176,76 +323,223 @@ struct Board {
     zobrist ^= Zobrist::stm_rand;
 
     halfmove_clock = 0;
+    // Callers only pass out of check, and the side that passed cannot have
+    // been giving check either. No piece moved, so the attack maps still hold
+    checkers = Bitboard();
+
+    return undo;
   }
 
-  // Does not account for pins
-  constexpr Bitboard threats(Side side) const {
-    Bitboard threats;
+  constexpr void unmake_null_move(const Undo &undo) {
+    stm = ~stm;
+    zobrist = undo.zobrist;
+    checkers = undo.checkers;
+    halfmove_clock = undo.halfmove_clock;
+    ep_square = undo.ep_square;
+  }
 
-    for (Piece p : std::views::drop(Pieces::ALL, 1)) {
-      Bitboard bb = pieces[side][p];
+  // Every square side attacks through occupancy, its own pieces included.
+  // Computed set-wise, without a loop over the pieces. Does not account for
+  // pins
+  constexpr Bitboard attack_map(Side side, Bitboard occupancy) const {
+    Bitboard queens = pieces(side, Pieces::QUEEN);
+
+    return slider_attacks(pieces(side, Pieces::ROOK) | queens,
+                          pieces(side, Pieces::BISHOP) | queens, occupancy) |
+           knight_attacks(pieces(side, Pieces::KNIGHT)) |
+           pawn_attacks_bb(side, pieces(side, Pieces::PAWN)) |
+           attacks_bb<Pieces::KING>(Square(pieces(side, Pieces::KING)),
+                                    occupancy);
+  }
+
+  // Enemy pieces giving check to STM, looked up from the king square
+  template <Side::Literal STM> constexpr Bitboard find_checkers() const {
+    Square king_square(pieces(STM, Pieces::KING));
+    Bitboard occupancy = general_occupancy(),
+             queens = pieces(~STM, Pieces::QUEEN);
+
+    return (pawn_attacks[STM][king_square] & pieces(~STM, Pieces::PAWN)) |
+           (attacks_bb<Pieces::KNIGHT>(king_square, occupancy) &
+            pieces(~STM, Pieces::KNIGHT)) |
+           (attacks_bb<Pieces::BISHOP>(king_square, occupancy) &
+            (pieces(~STM, Pieces::BISHOP) | queens)) |
+           (attacks_bb<Pieces::ROOK>(king_square, occupancy) &
+            (pieces(~STM, Pieces::ROOK) | queens));
+  }
 
-      while (bb)
-        threats |= attacks_bb(p, bb.pop_lsb(), general_occupancy);
+  // STM must be the side to move
+  template <Side::Literal STM> constexpr void update_attacks() {
+    attacks_known = {};
+    checkers = find_checkers<STM>();
+  }
+
+  // Squares side attacks, built from the pieces the first time they are
+  // asked for after a move
+  constexpr Bitboard attacks(Side side) const {
+    if (!attacks_known[side]) {
+      attacked[side] = attack_map(side, general_occupancy());
+      attacks_known[side] = true;
     }
 
-    Bitboard bb = pieces[side][Pieces::PAWN];
-    while (bb)
-      threats |= pawn_attacks[side][bb.pop_lsb()];
+    return attacked[side];
+  }
+
+  // Squares the king of STM cannot step to: the ones the enemy attacks and
+  // the ones behind it on the line of a checking slider, which the attack map
+  // sees as blocked by the king itself
+  template <Side::Literal STM> constexpr Bitboard king_danger() const {
+    Square king_square(pieces(STM, Pieces::KING));
+    Bitboard danger = attacks(~STM),
+             sliders = checkers & ~(piece_occupancy[Pieces::PAWN] |
+                                    piece_occupancy[Pieces::KNIGHT]);
+
+    while (sliders) {
+      Square slider = sliders.pop_lsb();
+      danger |= line_bb[king_square][slider] & ~Bitboard(slider);
+    }
 
-    return threats & ~side_occupancy[side];
+    return danger;
   }
 
   // Does not account for pins
-  constexpr bool is_attacked(Square square, Side side) const {
+  constexpr Bitboard threats(Side side) const {
+    return attacks(side) & ~side_occupancy[side];
+  }
+
+  // Does not account for pins
+  constexpr bool is_attacked(Square square, Side side,
+                             Bitboard occupancy) const {
     for (Piece p : std::views::drop(Pieces::ALL, 1))
-      if (attacks_bb(p, square, general_occupancy) & pieces[side][p])
+      if (attacks_bb(p, square, occupancy) & pieces(side, p))
         return true;
 
-    return pawn_attacks[~side][square] & pieces[side][Pieces::PAWN];
+    return pawn_attacks[~side][square] & pieces(side, Pieces::PAWN);
   }
 
-  constexpr bool is_legal() const {
-    return !is_attacked(Square(pieces[~stm][Pieces::KING]), stm);
+  constexpr bool is_attacked(Square square, Side side) const {
+    return is_attacked(square, side, general_occupancy());
   }
 
-  constexpr bool is_check() const {
-    return is_attacked(Square(pieces[stm][Pieces::KING]), ~stm);
-  }
+  constexpr bool is_check() const { return checkers; }
 
   constexpr bool is_draw() const {
     if (halfmove_clock >= 50)
       return true;
 
-    if (general_occupancy.popcount() > 3)
+    if (general_occupancy().popcount() > 3)
       return false;
 
     for (Side side : Sides::ALL)
       for (Piece piece : {Pieces::PAWN, Pieces::ROOK, Pieces::QUEEN})
-        if (pieces[side][piece])
+        if (pieces(side, piece))
           return false;
 
     return true;
   }
 
-  constexpr void generate_regular_moves(MoveList &move_list) const {
-    for (Piece p : std::views::drop(Pieces::ALL, 1)) {
-      Bitboard bb = pieces[stm][p];
+  // Pieces of STM that are the only blocker between their king and an enemy
+  // slider
+  template <Side::Literal STM> constexpr Bitboard pinned() const {
+    Square king_square(pieces(STM, Pieces::KING));
+    Bitboard queens = pieces(~STM, Pieces::QUEEN), pinned_bb,
+             snipers = (attacks_bb<Pieces::ROOK>(king_square, Bitboard()) &
+                        (pieces(~STM, Pieces::ROOK) | queens)) |
+                       (attacks_bb<Pieces::BISHOP>(king_square, Bitboard()) &
+                        (pieces(~STM, Pieces::BISHOP) | queens));
+
+    while (snipers) {
+      Bitboard blockers =
+          between_bb[king_square][snipers.pop_lsb()] & general_occupancy();
+
+      if (blockers.popcount() == 1)
+        pinned_bb |= blockers & side_occupancy[STM];
+    }
+
+    return pinned_bb;
+  }
+
+  // Squares a piece other than the king may move to while checkers_bb give
+  // check: anywhere out of check, onto the checker or between it and the king
+  // in single check, nowhere in double check
+  template <Side::Literal STM>
+  constexpr Bitboard check_mask(Bitboard checkers_bb) const {
+    if (!checkers_bb)
+      return ~Bitboard();
+
+    if (checkers_bb.popcount() > 1)
+      return Bitboard();
+
+    return checkers_bb | between_bb[Square(pieces(STM, Pieces::KING))]
+                                   [Square(checkers_bb)];
+  }
+
+  // En passant removes two pawns from one rank, which the pin mask does not
+  // see, so the king is checked against the position after the capture
+  template <Side::Literal STM>
+  constexpr bool is_legal_en_passant(Square from) const {
+    constexpr Direction down =
+        STM == Sides::WHITE ? Direction::SOUTH : Direction::NORTH;
+
+    Square king_square(pieces(STM, Pieces::KING)),
+        captured = ep_square.shift<down>();
+    Bitboard occupancy = (general_occupancy() ^ Bitboard(from) ^
+                          Bitboard(captured)) |
+                         Bitboard(ep_square);
+
+    return !(attacks_bb<Pieces::ROOK>(king_square, occupancy) &
+             (pieces(~STM, Pieces::ROOK) | pieces(~STM, Pieces::QUEEN))) &&
+           !(attacks_bb<Pieces::BISHOP>(king_square, occupancy) &
+             (pieces(~STM, Pieces::BISHOP) | pieces(~STM, Pieces::QUEEN))) &&
+           !(attacks_bb<Pieces::KNIGHT>(king_square, occupancy) &
+             pieces(~STM, Pieces::KNIGHT)) &&
+           !(pawn_attacks[STM][king_square] & pieces(~STM, Pieces::PAWN) &
+             ~Bitboard(captured));
+  }
+
+  // King steps onto targets outside the danger squares
+  template <Side::Literal STM>
+  constexpr void generate_king_moves(MoveList &move_list,
+                                     Bitboard targets) const {
+    Square from(pieces(STM, Pieces::KING));
+    Bitboard attacks = attacks_bb<Pieces::KING>(from, general_occupancy()) &
+                       targets & ~king_danger<STM>();
+
+    while (attacks) {
+      Square to = attacks.pop_lsb();
+      move_list.add(from, to, piece_on(to) != Pieces::NONE);
+    }
+  }
+
+  // Knight, bishop, rook and queen moves onto targets. Pinned pieces stay on
+  // the line through their king
+  template <Side::Literal STM>
+  constexpr void generate_regular_moves(MoveList &move_list, Bitboard targets,
+                                        Bitboard pinned_bb) const {
+    Square king_square(pieces(STM, Pieces::KING));
+
+    for (Piece p :
+         {Pieces::KNIGHT, Pieces::BISHOP, Pieces::ROOK, Pieces::QUEEN}) {
+      Bitboard bb = pieces(STM, p);
 
       while (bb) {
         Square from = bb.pop_lsb();
 
-        Bitboard attacks =
-            attacks_bb(p, from, general_occupancy) & ~side_occupancy[stm];
+        Bitboard attacks = attacks_bb(p, from, general_occupancy()) & targets;
+
+        if (pinned_bb & Bitboard(from))
+          attacks &= line_bb[king_square][from];
 
         while (attacks) {
           Square to = attacks.pop_lsb();
-          move_list.add(from, to, square_to_piece[to] != Pieces::NONE);
+          move_list.add(from, to, piece_on(to) != Pieces::NONE);
         }
       }
     }
   }
 
+  // Castling is always quiet and never an evasion. The attack masks include
+  // the king's square, so every move generated here is legal
+  template <Side::Literal STM>
   constexpr void generate_castling_moves(MoveList &move_list) const {
     static constexpr Sides::Array<std::array<Bitboard, 2>> free_masks = {
         0x60, 0xE, 0x6000000000000000, 0xE00000000000000};
@@ -253,63 +547,90 @@ struct Board {
     static constexpr Sides::Array<std::array<Bitboard, 2>> attack_masks = {
         0x70, 0x1C, 0x7000000000000000, 0x1c00000000000000};
 
-    Bitboard threats_bb = threats(~stm);
-    size_t castling_rank = stm == Sides::WHITE ? 0 : 7;
+    constexpr int castling_rank = STM == Sides::WHITE ? 0 : 7;
+
     Square king_square(castling_rank, 4);
 
     for (size_t i = 0; i < 2; ++i)
-      if (castling_rights[stm][i] &&
-          !(general_occupancy & free_masks[stm][i]) &&
-          !(threats_bb & attack_masks[stm][i]))
+      if (can_castle(STM, i) && !(general_occupancy() & free_masks[STM][i]) &&
+          !(attacks(~STM) & attack_masks[STM][i]))
         move_list.add(king_square, Square(castling_rank, 6 - 4 * i),
                       i == 0 ? Special::KING_CASTLE : Special::QUEEN_CASTLE);
   }
 
-  constexpr void generate_pawn_moves(MoveList &move_list) const {
-    Direction from, to;
+  // Pushes and captures landing on targets. Pinned pawns stay on the line
+  // through their king, and en passant is checked separately
+  template <GenType T, Side::Literal STM>
+  constexpr void generate_pawn_moves(MoveList &move_list,
+                                     Bitboard targets = ~Bitboard(),
+                                     Bitboard pinned_bb = Bitboard()) const {
+    constexpr Direction to =
+        STM == Sides::WHITE ? Direction::NORTH : Direction::SOUTH;
+    constexpr Direction from =
+        STM == Sides::WHITE ? Direction::SOUTH : Direction::NORTH;
+    constexpr Bitboard last_rank = STM == Sides::WHITE ? Bitboards::Rank8
+                                                       : Bitboards::Rank1,
+                       third_rank = STM == Sides::WHITE ? Bitboards::Rank3
+                                                        : Bitboards::Rank6;
+
+    Square king_square(pieces(STM, Pieces::KING));
+    Bitboard bb = pieces(STM, Pieces::PAWN),
+             single_pushes = bb.shift<to>() & ~general_occupancy(),
+             double_pushes = (single_pushes & third_rank).shift<to>() &
+                             ~general_occupancy() & targets,
+             promotions = single_pushes & last_rank & targets;
+
+    single_pushes &= ~last_rank & targets;
+
+    auto is_unpinned = [&](Square from, Square to) {
+      return !(pinned_bb & Bitboard(from)) ||
+             (line_bb[king_square][from] & Bitboard(to));
+    };
+
+    if constexpr (T != GenType::NOISY) {
+      while (single_pushes) {
+        Square to = single_pushes.pop_lsb();
+
+        if (is_unpinned(to.shift(from), to))
+          move_list.add(to.shift(from), to, false);
+      }
 
-    if (stm == Sides::WHITE) {
-      to = Direction::NORTH;
-      from = Direction::SOUTH;
-    } else {
-      to = Direction::SOUTH;
-      from = Direction::NORTH;
-    }
+      while (double_pushes) {
+        Square to = double_pushes.pop_lsb();
 
-    Bitboard bb = pieces[stm][Pieces::PAWN],
-             last_rank =
-                 stm == Sides::WHITE ? Bitboards::Rank8 : Bitboards::Rank1,
-             third_rank =
-                 stm == Sides::WHITE ? Bitboards::Rank3 : Bitboards::Rank6,
-             single_pushes = bb.shift(to) & ~general_occupancy,
-             double_pushes =
-                 (single_pushes & third_rank).shift(to) & ~general_occupancy;
-
-    while (single_pushes) {
-      Square to = single_pushes.pop_lsb();
-
-      if (last_rank & Bitboard(to))
-        for (Piece p :
-             {Pieces::KNIGHT, Pieces::BISHOP, Pieces::ROOK, Pieces::QUEEN}) {
-          move_list.add(to.shift(from), to, false, p);
-        }
-      else
-        move_list.add(to.shift(from), to, false);
+        if (is_unpinned(to.shift(from).shift(from), to))
+          move_list.add(to.shift(from).shift(from), to, Special::DOUBLE_PUSH);
+      }
     }
 
-    while (double_pushes) {
+    while (promotions) {
+      Square to = promotions.pop_lsb();
+
+      if (!is_unpinned(to.shift(from), to))
+        continue;
+
+      if constexpr (T != GenType::QUIET)
+        move_list.add(to.shift(from), to, false, Pieces::QUEEN);
 
-      Square to = double_pushes.pop_lsb();
-      move_list.add(to.shift(from).shift(from), to, Special::DOUBLE_PUSH);
+      if constexpr (T != GenType::NOISY)
+        for (Piece p : {Pieces::KNIGHT, Pieces::BISHOP, Pieces::ROOK})
+          move_list.add(to.shift(from), to, false, p);
     }
 
+    if constexpr (T == GenType::QUIET)
+      return;
+
     while (bb) {
       Square from = bb.pop_lsb();
-      Bitboard attacks = pawn_attacks[stm][from] & side_occupancy[~stm];
+      Bitboard attacks =
+          pawn_attacks[STM][from] & side_occupancy[~STM] & targets;
 
       while (attacks) {
         Square to = attacks.pop_lsb();
 
+        if (!is_unpinned(from, to))
+          continue;
+
         if (last_rank & Bitboard(to))
           for (Piece p :
                {Pieces::KNIGHT, Pieces::BISHOP, Pieces::ROOK, Pieces::QUEEN})
@@ -321,40 +642,118 @@ struct Board {
 
     if (ep_square != Squares::NONE) {
       Bitboard attackers =
-          pawn_attacks[~stm][ep_square] & pieces[stm][Pieces::PAWN];
+          pawn_attacks[~STM][ep_square] & pieces(STM, Pieces::PAWN);
 
       while (attackers) {
         Square from = attackers.pop_lsb();
-        move_list.add(from, ep_square, Special::EN_PASSANT);
+
+        if (is_legal_en_passant<STM>(from))
+          move_list.add(from, ep_square, Special::EN_PASSANT);
       }
     }
   }
 
-  constexpr MoveList pseudolegal_moves() const {
+  // Generates legal moves only for STM, which must be the side to move. NOISY
+  // and QUIET partition the legal moves, EVASIONS yields all of them at once
+  // and is meant for positions in check
+  template <GenType T, Side::Literal STM>
+  constexpr void generate_moves(MoveList &move_list) const {
+    // Everything below indexes tables by the king square. Like every assert
+    // here this also aborts release builds, which do not define NDEBUG
+    assert(pieces(STM, Pieces::KING));
+
+    Bitboard targets = T == GenType::NOISY   ? side_occupancy[~STM]
+                       : T == GenType::QUIET ? ~general_occupancy()
+                                             : ~side_occupancy[STM];
+
+    generate_king_moves<STM>(move_list, targets);
+
+    // Only the king can answer a double check
+    if (checkers.popcount() > 1)
+      return;
+
+    Bitboard pinned_bb = pinned<STM>(), mask = check_mask<STM>(checkers);
+
+    generate_regular_moves<STM>(move_list, targets & mask, pinned_bb);
+    generate_pawn_moves<T, STM>(move_list, mask, pinned_bb);
+
+    if (T == GenType::QUIET && !checkers)
+      generate_castling_moves<STM>(move_list);
+  }
+
+  template <GenType T>
+  constexpr void generate_moves(MoveList &move_list) const {
+    if (stm == Sides::WHITE)
+      generate_moves<T, Sides::WHITE>(move_list);
+    else
+      generate_moves<T, Sides::BLACK>(move_list);
+  }
+
+  template <Side::Literal STM> constexpr MoveList legal_moves() const {
     MoveList moves;
 
-    generate_regular_moves(moves);
-    generate_castling_moves(moves);
-    generate_pawn_moves(moves);
+    generate_moves<GenType::NOISY, STM>(moves);
+    generate_moves<GenType::QUIET, STM>(moves);
 
     return moves;
-  };
+  }
+
+  constexpr MoveList legal_moves() const {
+    return stm == Sides::WHITE ? legal_moves<Sides::WHITE>()
+                               : legal_moves<Sides::BLACK>();
+  }
+
+  // Checks a move that did not come from this position's generator, such as a
+  // TT or killer move, without generating every move
+  template <Side::Literal STM> constexpr bool is_pseudolegal(Move m) const {
+    Piece piece = piece_on(m.from());
+
+    if (piece == Pieces::NONE || !(side_occupancy[STM] & Bitboard(m.from())))
+      return false;
+
+    if (piece == Pieces::PAWN || m.is_castle()) {
+      MoveList moves;
+
+      if (m.is_castle())
+        generate_castling_moves<STM>(moves);
+      else if (m.is_noisy())
+        generate_pawn_moves<GenType::NOISY, STM>(moves);
+      else
+        generate_pawn_moves<GenType::QUIET, STM>(moves);
+
+      return std::ranges::contains(moves, m);
+    }
+
+    return (attacks_bb(piece, m.from(), general_occupancy()) &
+            ~side_occupancy[STM] & Bitboard(m.to())) &&
+           m == Move(m.from(), m.to(), piece_on(m.to()) != Pieces::NONE);
+  }
+
+  // Whether a pseudolegal move leaves the king safe. Castling and en passant
+  // are already fully checked by is_pseudolegal
+  template <Side::Literal STM> constexpr bool is_legal(Move m) const {
+    Square king_square(pieces(STM, Pieces::KING));
+
+    if (m.is_castle() || m.is_en_passant())
+      return true;
+
+    if (m.from() == king_square)
+      return !(king_danger<STM>() & Bitboard(m.to()));
+
+    return (check_mask<STM>(checkers) & Bitboard(m.to())) &&
+           (!(pinned<STM>() & Bitboard(m.from())) ||
+            (line_bb[king_square][m.from()] & Bitboard(m.to())));
+  }
 
   constexpr uint64_t hash() const {
     uint64_t hash = 0;
 
-    for (auto [square, piece] : std::views::zip(Squares::ALL, square_to_piece))
-      if (piece != Pieces::NONE) {
-        Side side = pieces[Sides::WHITE][piece] & Bitboard(square)
-                        ? Sides::WHITE
-                        : Sides::BLACK;
-        hash ^= Zobrist::square_rands[square][piece][side];
-      }
+    for (Square square : Squares::ALL)
+      if (piece_on(square) != Pieces::NONE)
+        hash ^= Zobrist::square_rands[square][piece_on(square)]
+                                     [side_on(square)];
 
-    for (Side side : Sides::ALL)
-      for (int i = 0; i < 2; ++i)
-        if (castling_rights[side][i])
-          hash ^= Zobrist::castling_rands[side][i];
+    hash ^= Zobrist::castling_rands[castling_rights];
 
     if (ep_square != Squares::NONE)
       hash ^= Zobrist::ep_rands[ep_square.file()];
@@ -379,23 +778,21 @@ template <> struct std::formatter<Board> {
       for (int file = 0; file < 8; ++file) {
         out = std::format_to(
             out, "{} ",
-            board.square_to_piece[Square(rank, file)].repr(
-                board.side_occupancy[Sides::WHITE] & Bitboard(rank, file)
-                    ? Sides::WHITE
-                    : Sides::BLACK));
+            board.piece_on(Square(rank, file))
+                .repr(board.side_on(Square(rank, file))));
       }
 
       out = std::format_to(out, "\t{}\n", rank + 1);
     }
 
     std::string castling;
-    if (board.castling_rights[Sides::WHITE][0])
+    if (board.can_castle(Sides::WHITE, 0))
       castling += 'K';
-    if (board.castling_rights[Sides::WHITE][1])
+    if (board.can_castle(Sides::WHITE, 1))
       castling += 'Q';
-    if (board.castling_rights[Sides::BLACK][0])
+    if (board.can_castle(Sides::BLACK, 0))
       castling += 'k';
-    if (board.castling_rights[Sides::BLACK][1])
+    if (board.can_castle(Sides::BLACK, 1))
       castling += 'q';
     if (castling.empty())
       castling = "-";
@@ -409,65 +806,298 @@ template <> struct std::formatter<Board> {
 };
 
 struct NetBoard : public Board {
-  Sides::Array<Accumulator> acc;
+  struct Feature {
+    Side side;
+    Piece piece;
+    Square square;
+
+    constexpr bool operator==(const Feature &) const = default;
+  };
+
+  // Which weights a perspective's features use, decided by its own king
+  struct KingBucket {
+    int bucket;
+    bool mirrored;
+
+    constexpr bool operator==(const KingBucket &) const = default;
+  };
+
+  // Features the move being made adds and removes. A piece that arrives and
+  // leaves within the same move, like a promoting pawn, cancels out, so a move
+  // never has more than two of either. A perspective whose king changes bucket
+  // is refreshed instead
+  struct FeatureDelta {
+    std::array<Feature, 2> added, removed;
+    int num_added = 0, num_removed = 0;
+    Sides::Array<bool> refresh{};
+  };
+
+  // The accumulators of one ply and the delta from the ply below. Entries
+  // above the last computed one only hold their delta until eval needs them
+  struct AccumulatorEntry {
+    Sides::Array<Accumulator> accumulators;
+    FeatureDelta delta;
+    Sides::Array<bool> computed;
+  };
+
+  // The accumulator of the pieces a perspective last had with its king in one
+  // bucket. Refreshing from it only applies the pieces that changed since
+  struct RefreshEntry {
+    Accumulator accumulator;
+    Pieces::Array<Bitboard> piece_occupancy;
+    Sides::Array<Bitboard> side_occupancy;
+  };
+
+  // One entry per ply made since this board was created or copied, up to and
+  // including top. Entries above top are kept around for reuse
+  std::vector<AccumulatorEntry> stack;
+  std::size_t top;
   std::reference_wrapper<const PerspectiveNetwork> net;
+  // Indexed by refresh_index
+  std::vector<RefreshEntry> refresh_table;
+
+  // These hide Board's piece helpers and are picked up statically by
+  // Board::make_move<NetBoard>. They only record the features, which
+  // eval applies lazily
+  template <Side::Literal SIDE>
+  constexpr void add_piece(Piece piece, Square square) {
+    Board::add_piece<SIDE>(piece, square);
+    record<true>({SIDE, piece, square});
+  }
+
+  template <Side::Literal SIDE>
+  constexpr void remove_piece(Piece piece, Square square) {
+    Board::remove_piece<SIDE>(piece, square);
+    record<false>({SIDE, piece, square});
+  }
+
+  template <Side::Literal SIDE>
+  constexpr void move_piece(Piece piece, Square from, Square to) {
+    Board::move_piece<SIDE>(piece, from, to);
+    record<false>({SIDE, piece, from});
+    record<true>({SIDE, piece, to});
+
+    if (piece == Pieces::KING &&
+        king_bucket(SIDE, from) != king_bucket(SIDE, to))
+      stack[top].delta.refresh[SIDE] = true;
+  }
+
+  template <bool ADD> constexpr void record(Feature feature) {
+    FeatureDelta &delta = stack[top].delta;
+    std::array<Feature, 2> &same = ADD ? delta.added : delta.removed,
+                           &opposite = ADD ? delta.removed : delta.added;
+    int &num_same = ADD ? delta.num_added : delta.num_removed,
+        &num_opposite = ADD ? delta.num_removed : delta.num_added;
+
+    for (int i = 0; i < num_opposite; ++i)
+      if (opposite[i] == feature) {
+        opposite[i] = opposite[--num_opposite];
+        return;
+      }
+
+    assert(num_same < 2);
+    same[num_same++] = feature;
+  }
+
+  static constexpr KingBucket king_bucket(Side perspective, Square king) {
+    Square relative(king.raw() ^ (perspective == Sides::BLACK) * 56);
+    bool mirrored = MIRROR_KING && relative.file() >= 4;
+
+    return {KING_BUCKET_LAYOUT[relative.raw() ^ mirrored * 7], mirrored};
+  }
 
-  constexpr virtual void add_piece(Side side, Piece piece,
-                                   Square square) override {
-    Board::add_piece(side, piece, square);
-    update_accumulators(net, square, piece, side);
+  constexpr KingBucket king_bucket(Side perspective) const {
+    return king_bucket(perspective,
+                       Square(pieces(perspective, Pieces::KING)));
   }
 
-  constexpr virtual void remove_piece(Side side, Piece piece,
-                                      Square square) override {
-    Board::remove_piece(side, piece, square);
-    update_accumulators<false>(net, square, piece, side);
+  // The feature's row in the given perspective. Each bucket has 768 rows. A
+  // piece's features sit in the first half of its own side's rows and in the
+  // second half of the other one, with black's board flipped vertically and
+  // mirrored buckets flipped horizontally
+  static constexpr int feature_index(Side perspective, KingBucket king,
+                                     Feature feature) {
+    int flip = (perspective == Sides::BLACK) * 56 ^ king.mirrored * 7;
+
+    return 768 * king.bucket +
+           64 * Pieces::NUM * (feature.side != perspective) +
+           64 * feature.piece.raw() + (feature.square.raw() ^ flip);
   }
 
-  constexpr virtual void move_piece(Side side, Piece piece, Square from,
-                                    Square to) override {
-    Board::move_piece(side, piece, from, to);
-    update_accumulators<false>(net, from, piece, side);
-    update_accumulators(net, to, piece, side);
+  static constexpr std::size_t refresh_index(Side perspective,
+                                             KingBucket king) {
+    return (KING_BUCKETS * (perspective == Sides::BLACK) + king.bucket) * 2 +
+           king.mirrored;
   }
 
-  template <bool ADD = true>
-  void update_accumulators(const PerspectiveNetwork &net, Square square,
-                           Piece piece, Side side) {
-    auto op = std::mem_fn(ADD ? &Accumulator::operator+=
-                  : &Accumulator::operator-=);
+  template <std::size_t ADDS, std::size_t SUBS>
+  void apply_delta(const FeatureDelta &delta, Side perspective,
+                   KingBucket king, Accumulator &out,
+                   const Accumulator &in) const {
+    const PerspectiveNetwork &net = this->net;
+    std::array<const int16_t *, ADDS> added;
+    std::array<const int16_t *, SUBS> removed;
+
+    for (std::size_t i = 0; i < ADDS; ++i)
+      added[i] =
+          net.get_hl_line(feature_index(perspective, king, delta.added[i]))
+              .state.data();
+
+    for (std::size_t i = 0; i < SUBS; ++i)
+      removed[i] =
+          net.get_hl_line(feature_index(perspective, king, delta.removed[i]))
+              .state.data();
+
+    Simd::add_sub<HL>(out.state.data(), in.state.data(), added, removed);
+  }
+
+  // Computes one perspective of an entry from the one below it, which is read
+  // and written once: quiet moves and promotions add one row and remove one,
+  // captures remove two, castling adds and removes two. The king is in the
+  // same bucket on every ply of the chain, so the current one is used
+  void compute_entry(Side perspective, std::size_t index) {
+    const FeatureDelta &delta = stack[index].delta;
+    KingBucket king = king_bucket(perspective);
+    Accumulator &out = stack[index].accumulators[perspective];
+    const Accumulator &in = stack[index - 1].accumulators[perspective];
+
+    if (delta.num_added == 1 && delta.num_removed == 1)
+      apply_delta<1, 1>(delta, perspective, king, out, in);
+    else if (delta.num_added == 1 && delta.num_removed == 2)
+      apply_delta<1, 2>(delta, perspective, king, out, in);
+    else
+      apply_delta<2, 2>(delta, perspective, king, out, in);
+
+    stack[index].computed[perspective] = true;
+  }
+
+  // Brings the cached accumulator of the king's current bucket up to date with
+  // the pieces on the board and copies it to the top entry
+  void refresh(Side perspective) {
+    KingBucket king = king_bucket(perspective);
+    RefreshEntry &entry = refresh_table[refresh_index(perspective, king)];
+    const PerspectiveNetwork &net = this->net;
+
+    for (Side side : Sides::ALL)
+      for (Piece piece : Pieces::ALL) {
+        Bitboard now = pieces(side, piece),
+                 then = entry.piece_occupancy[piece] &
+                        entry.side_occupancy[side],
+                 added = now & ~then, removed = then & ~now;
+
+        while (added)
+          entry.accumulator += net.get_hl_line(
+              feature_index(perspective, king, {side, piece, added.pop_lsb()}));
+
+        while (removed)
+          entry.accumulator -= net.get_hl_line(feature_index(
+              perspective, king, {side, piece, removed.pop_lsb()}));
+      }
+
+    entry.piece_occupancy = piece_occupancy;
+    entry.side_occupancy = side_occupancy;
+    stack[top].accumulators[perspective] = entry.accumulator;
+    stack[top].computed[perspective] = true;
+  }
+
+  constexpr std::size_t last_computed(Side perspective) const {
+    std::size_t index = top;
+
+    while (!stack[index].computed[perspective])
+      --index;
+
+    return index;
+  }
 
-    if (side == Sides::WHITE) {
-      op(acc[Sides::WHITE], net.get_hl_line(64 * piece.raw() + square.raw()));
-      op(acc[Sides::BLACK], net.get_hl_line(64 * (piece.raw() + Pieces::NUM) +
-                                            (square.raw() ^ 56)));
-    } else {
-      op(acc[Sides::WHITE],
-         net.get_hl_line(64 * (piece.raw() + Pieces::NUM) + square.raw()));
-      op(acc[Sides::BLACK],
-         net.get_hl_line(64 * piece.raw() + (square.raw() ^ 56)));
+  // Walks up from the last computed entry, or refreshes if the king changed
+  // bucket on the way. Positions that are never evaluated, such as pruned
+  // children, cost no network updates
+  const Sides::Array<Accumulator> &current_accumulators() {
+    for (Side perspective : Sides::ALL) {
+      std::size_t index = top;
+
+      while (!stack[index].computed[perspective] &&
+             !stack[index].delta.refresh[perspective])
+        --index;
+
+      if (!stack[index].computed[perspective])
+        refresh(perspective);
+      else
+        while (++index <= top)
+          compute_entry(perspective, index);
     }
+
+    return stack[top].accumulators;
+  }
+
+  void push_entry() {
+    if (++top == stack.size())
+      stack.emplace_back();
+
+    stack[top].delta = {};
+    stack[top].computed = {};
+  }
+
+  // Every cache entry starts out as an empty board
+  void reset_refresh_table() {
+    refresh_table.assign(2 * KING_BUCKETS * 2,
+                         {net.get().get_hl_biases(), {}, {}});
   }
 
   constexpr NetBoard(std::string_view fen_string, const PerspectiveNetwork &net)
-      : Board(fen_string), net(net) {
-    acc[Sides::WHITE] = acc[Sides::BLACK] = net.get_hl_biases();
-
-    std::ranges::for_each(square_to_piece | std::views::enumerate |
-                              std::views::filter([](auto p) {
-                                return get<1>(p) != Pieces::NONE;
-                              }),
-                          [&](auto p) {
-                            Square square(get<0>(p));
-                            Piece piece = get<1>(p);
-
-                            update_accumulators(net, square, piece,
-                                                pieces[Sides::WHITE][piece] &
-                                                        Bitboard(square)
-                                                    ? Sides::WHITE
-                                                    : Sides::BLACK);
-                          });
-  }
-
-  constexpr int eval() const { return net.get().compute(acc[stm], acc[~stm]); }
+      : Board(fen_string), stack(1), top(0), net(net) {
+    reset_refresh_table();
+
+    for (Side perspective : Sides::ALL)
+      refresh(perspective);
+  }
+
+  constexpr std::size_t first_needed() const {
+    return std::min(last_computed(Sides::WHITE), last_computed(Sides::BLACK));
+  }
+
+  // A copy only keeps the entries the current accumulators still depend on,
+  // the plies below them can only be unmade on the original
+  constexpr NetBoard(const NetBoard &other)
+      : Board(other), stack(other.stack.begin() + other.first_needed(),
+                            other.stack.begin() + other.top + 1),
+        top(stack.size() - 1), net(other.net),
+        refresh_table(other.refresh_table) {}
+
+  constexpr NetBoard &operator=(const NetBoard &other) {
+    Board::operator=(other);
+    stack.assign(other.stack.begin() + other.first_needed(),
+                 other.stack.begin() + other.top + 1);
+    top = stack.size() - 1;
+    net = other.net;
+    refresh_table = other.refresh_table;
+    return *this;
+  }
+
+  template <Side::Literal STM> constexpr Undo make_move(Move m) {
+    push_entry();
+    return Board::make_move<STM, NetBoard>(m);
+  }
+
+  constexpr Undo make_move(Move m) {
+    push_entry();
+    return Board::make_move<NetBoard>(m);
+  }
+
+  template <Side::Literal STM>
+  constexpr void unmake_move(Move m, const Undo &undo) {
+    Board::unmake_move<STM>(m, undo);
+    --top;
+  }
+
+  constexpr void unmake_move(Move m, const Undo &undo) {
+    Board::unmake_move(m, undo);
+    --top;
+  }
+
+  // Not const, computes any pending accumulators first
+  int eval() {
+    const Sides::Array<Accumulator> &acc = current_accumulators();
+    return net.get().compute(acc[stm], acc[~stm]);
+  }
 };
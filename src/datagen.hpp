@@ -28,25 +28,25 @@ struct MarlinFormat {
   const uint8_t padding = 0;
 
   constexpr MarlinFormat(const Board &board)
-      : occupancy(board.general_occupancy.raw()), pieces{},
+      : occupancy(board.general_occupancy().raw()), pieces{},
         ep_square(board.ep_square.raw() |
                   (board.stm == Sides::WHITE ? 0 : (1 << 7))),
         halfmove_clock(board.halfmove_clock) {
-    Bitboard bb = board.general_occupancy;
+    Bitboard bb = board.general_occupancy();
     int index = 0;
 
     while (bb) {
       Square square = bb.pop_lsb();
-      uint8_t piece = board.square_to_piece[square].raw();
+      uint8_t piece = board.piece_on(square).raw();
 
       if (piece == 3 &&
-          ((square == Squares::A1 && board.castling_rights[Sides::WHITE][1]) ||
-           (square == Squares::A8 && board.castling_rights[Sides::BLACK][1]) ||
-           (square == Squares::H1 && board.castling_rights[Sides::WHITE][0]) ||
-           (square == Squares::H8 && board.castling_rights[Sides::BLACK][0])))
+          ((square == Squares::A1 && board.can_castle(Sides::WHITE, 1)) ||
+           (square == Squares::A8 && board.can_castle(Sides::BLACK, 1)) ||
+           (square == Squares::H1 && board.can_castle(Sides::WHITE, 0)) ||
+           (square == Squares::H8 && board.can_castle(Sides::BLACK, 0))))
         piece = 6;
 
-      if (board.side_occupancy[Sides::BLACK] & Bitboard(square))
+      if (board.side_on(square) == Sides::BLACK)
         piece |= 8;
 
       pieces.set(index++, piece);
@@ -70,20 +70,13 @@ Game play_datagen_game(BoardType board) {
   int initial_moves = 8 + dist01(gen);
 
   for (int i = 0; i < initial_moves; ++i) {
-    MoveList moves = board.pseudolegal_moves();
-    int legal_moves = std::partition(moves.begin(), moves.end(),
-                                     [&](const Move &move) {
-                                       BoardType copy = board;
-                                       copy.make_move(move);
-                                       return copy.is_legal();
-                                     }) -
-                      moves.begin();
-
-    if (legal_moves == 0)
+    MoveList moves = board.legal_moves();
+
+    if (moves.size() == 0)
       return play_datagen_game(board);
     else
       board.make_move(
-          moves[std::uniform_int_distribution<>(0, legal_moves - 1)(gen)]);
+          moves[std::uniform_int_distribution<>(0, moves.size() - 1)(gen)]);
   }
 
   Searcher searcher;
@@ -7,6 +7,8 @@
 inline constexpr int INF = std::numeric_limits<short>::max();
 inline constexpr int CHECKMATE = INF - 1;
 inline constexpr int MAX_PLY = 256;
+// The TT stores depths in a signed byte
+inline constexpr int MAX_DEPTH = std::numeric_limits<int8_t>::max();
 inline constexpr int CHECKMATE_THRESHOLD = CHECKMATE - MAX_PLY;
 
 namespace Eval {
@@ -148,10 +150,10 @@ constexpr int eval(const Board &board) {
   int gamephase = 0;
 
   for (Square square : Squares::ALL) {
-    Piece piece = board.square_to_piece[square];
+    Piece piece = board.piece_on(square);
 
     if (piece != Pieces::NONE) {
-      if (board.pieces[Sides::WHITE][piece] & Bitboard(square)) {
+      if (board.side_on(square) == Sides::WHITE) {
         mg_side_eval[Sides::WHITE] +=
             mg_value[piece] + mg_pesto_table[piece][Square(square.raw() ^ 56)];
         eg_side_eval[Sides::WHITE] +=
@@ -263,9 +263,22 @@ inline constexpr Squares::Array<Pieces::Array<Sides::Array<uint64_t>>>
 
 inline constexpr uint64_t stm_rand = 0x469a8453908236f;
 
-inline constexpr Sides::Array<std::array<uint64_t, 2>> castling_rands{
-    0x24700a5fb94e062e, 0xc2e28bc9a5335e0e, 0x388e41bc9cee55c6,
-    0x72bcd3908568bb34};
+// Indexed by the whole 4-bit castling mask (bit 2 * side + i, i = 0 for the
+// king side), each entry XORs together the keys of the rights it holds
+inline constexpr std::array<uint64_t, 16> castling_rands = []() {
+  constexpr std::array<uint64_t, 4> rights_rands{
+      0x24700a5fb94e062e, 0xc2e28bc9a5335e0e, 0x388e41bc9cee55c6,
+      0x72bcd3908568bb34};
+
+  std::array<uint64_t, 16> rands{};
+
+  for (std::size_t mask = 0; mask < rands.size(); ++mask)
+    for (std::size_t right = 0; right < rights_rands.size(); ++right)
+      if (mask & (1 << right))
+        rands[mask] ^= rights_rands[right];
+
+  return rands;
+}();
 
 inline constexpr std::array<uint64_t, 8> ep_rands{
     0x51386ecce05335b9, 0x2b076463851c7805, 0xe820b0a867247c8f,
@@ -2,7 +2,12 @@
 #include "uciengine.hpp"
 
 int main(int argc, char *argv[]) {
-  UCIEngine<NetBoard>(STARTPOS,
-                      PerspectiveNetwork(argc > 1 ? argv[1] : NET_PATH))
-      .play();
+  try {
+    UCIEngine<NetBoard>(STARTPOS,
+                        PerspectiveNetwork(argc > 1 ? argv[1] : NET_PATH))
+        .play();
+  } catch (const std::runtime_error &error) {
+    std::println(stderr, "{}", error.what());
+    return 1;
+  }
 }
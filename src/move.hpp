@@ -65,6 +65,13 @@ struct Move {
 
   constexpr bool is_quiet() const { return !is_capture() && !is_promotion(); }
 
+  // Captures and queen promotions, the moves generated by GenType::NOISY.
+  // Quiet underpromotions are neither noisy nor is_quiet()
+  constexpr bool is_noisy() const {
+    return is_capture() ||
+           (is_promotion() && promoted_to() == Pieces::QUEEN);
+  }
+
   constexpr Piece promoted_to() const {
     return Piece(static_cast<Piece::Literal>(((data >> 12) & 0b11) + 1));
   }
@@ -0,0 +1,156 @@
+#pragma once
+
+#include "board.hpp"
+#include <algorithm>
+#include <array>
+#include <span>
+
+// Yields moves in stages so that work for later stages is skipped whenever an
+// earlier move causes a cutoff: the TT move (checked without generating
+// anything), noisy moves by MVV-LVA, killers, then quiets by history. In check
+// all evasions are generated at once and split the same way. STM must be the
+// side to move
+template <Side::Literal STM> class MovePicker {
+  enum class Stage {
+    TT_MOVE,
+    GENERATE_NOISY,
+    NOISY,
+    KILLERS,
+    GENERATE_QUIETS,
+    QUIETS,
+    DONE
+  };
+
+  static constexpr EnumArray<Piece::Literal, Pieces::Array<int>, 7>
+      mvv_lva_lookup{
+          // clang-format off
+          15, 14, 13, 12, 11, 10,
+          25, 24, 23, 22, 21, 20,
+          35, 34, 33, 32, 31, 30,
+          45, 44, 43, 42, 41, 40,
+          55, 54, 53, 52, 51, 50,
+          65, 64, 63, 62, 61, 60,
+           0,  0,  0,  0,  0,  0,
+          // clang-format on
+      };
+
+  const Board &board;
+  const Move tt_move;
+  const std::array<Move, 2> &killers;
+  const Squares::Array<Squares::Array<int>> &history;
+  const bool in_check, noisy_only;
+
+  Stage stage = Stage::TT_MOVE;
+  std::array<ScoredMove, MAX_MOVES> moves;
+  std::size_t current = 0, noisy_end = 0, moves_end = 0, killer_index = 0;
+  // Killers already yielded, skipped again in the quiet stage
+  std::array<Move, 2> played_killers{};
+
+  // Selection sort step: moves the best remaining move of [current, end) to
+  // the front. Ties keep generation order
+  Move pick_best(std::size_t end) {
+    std::size_t best = current;
+
+    for (std::size_t i = current + 1; i < end; ++i)
+      if (moves[i].score > moves[best].score)
+        best = i;
+
+    std::rotate(moves.begin() + current, moves.begin() + best,
+                moves.begin() + best + 1);
+
+    return moves[current++];
+  }
+
+public:
+  MovePicker(const Board &board, Move tt_move,
+             const std::array<Move, 2> &killers,
+             const Squares::Array<Squares::Array<int>> &history,
+             bool in_check, bool noisy_only = false)
+      : board(board), tt_move(tt_move), killers(killers), history(history),
+        in_check(in_check), noisy_only(noisy_only) {}
+
+  // Returns Move{} once every move has been yielded
+  Move next() {
+    switch (stage) {
+    case Stage::TT_MOVE:
+      stage = Stage::GENERATE_NOISY;
+
+      if (tt_move != Move{} && (!noisy_only || tt_move.is_noisy()) &&
+          board.is_pseudolegal<STM>(tt_move) && board.is_legal<STM>(tt_move))
+        return tt_move;
+
+      [[fallthrough]];
+    case Stage::GENERATE_NOISY: {
+      MoveList move_list;
+
+      if (in_check)
+        board.generate_moves<GenType::EVASIONS, STM>(move_list);
+      else
+        board.generate_moves<GenType::NOISY, STM>(move_list);
+
+      for (Move move : move_list)
+        if (move.is_noisy())
+          moves[noisy_end++] =
+              ScoredMove(mvv_lva_lookup[board.piece_on(move.to())]
+                                       [board.piece_on(move.from())],
+                         move);
+
+      moves_end = noisy_end;
+
+      if (in_check && !noisy_only)
+        for (Move move : move_list)
+          if (!move.is_noisy())
+            moves[moves_end++] = ScoredMove(0, move);
+
+      stage = Stage::NOISY;
+      [[fallthrough]];
+    }
+    case Stage::NOISY:
+      while (current < noisy_end)
+        if (Move move = pick_best(noisy_end); move != tt_move)
+          return move;
+
+      stage = noisy_only ? Stage::DONE : Stage::KILLERS;
+      return next();
+    case Stage::KILLERS:
+      while (killer_index < killers.size()) {
+        Move killer = killers[killer_index++];
+
+        if (killer.is_quiet() && killer != Move{} && killer != tt_move &&
+            !std::ranges::contains(played_killers, killer) &&
+            board.is_pseudolegal<STM>(killer) && board.is_legal<STM>(killer))
+          return played_killers[killer_index - 1] = killer;
+      }
+
+      stage = Stage::GENERATE_QUIETS;
+      [[fallthrough]];
+    case Stage::GENERATE_QUIETS:
+      if (!in_check) {
+        MoveList move_list;
+        board.generate_moves<GenType::QUIET, STM>(move_list);
+
+        for (Move move : move_list)
+          moves[moves_end++] = ScoredMove(0, move);
+      }
+
+      for (ScoredMove &move :
+           std::span(moves.begin() + noisy_end, moves.begin() + moves_end))
+        move.score = history[move.from()][move.to()];
+
+      stage = Stage::QUIETS;
+      [[fallthrough]];
+    case Stage::QUIETS:
+      while (current < moves_end)
+        if (Move move = pick_best(moves_end);
+            move != tt_move && !std::ranges::contains(played_killers, move))
+          return move;
+
+      stage = Stage::DONE;
+      [[fallthrough]];
+    case Stage::DONE:
+      return Move{};
+    }
+
+    return Move{};
+  }
+};
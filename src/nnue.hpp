@@ -1,14 +1,21 @@
 #pragma once
 
 #include "assert.h"
+#include "simd.hpp"
 #include "tunable_params.hpp"
+#include <algorithm>
 #include <array>
+#include <cstddef>
 #include <cstdint>
 #include <filesystem>
+#include <format>
 #include <fstream>
-#include <numeric>
+#include <span>
+#include <stdexcept>
+#include <string>
 
-struct Accumulator {
+// Aligned for the widest vector loads in simd.hpp
+struct alignas(64) Accumulator {
   std::array<int16_t, HL> state;
 
   constexpr Accumulator() : state{} {}
@@ -18,61 +25,131 @@ struct Accumulator {
 
   Accumulator operator+(const Accumulator &other) const {
     Accumulator result = *this;
-
-    std::transform(state.begin(), state.end(), other.state.begin(),
-                   result.state.begin(), std::plus{});
-
-    return result;
+    return result += other;
   }
 
   Accumulator &operator+=(const Accumulator &other) {
-    std::transform(state.begin(), state.end(), other.state.begin(),
-                   state.begin(), std::plus{});
+    Simd::update<true, HL>(state.data(), other.state.data());
     return *this;
   }
 
   Accumulator operator-(const Accumulator &other) const {
     Accumulator result = *this;
-
-    std::transform(state.begin(), state.end(), other.state.begin(),
-                   result.state.begin(), std::minus{});
-
-    return result;
+    return result -= other;
   }
 
   Accumulator &operator-=(const Accumulator &other) {
-    std::transform(state.begin(), state.end(), other.state.begin(),
-                   state.begin(), std::minus{});
+    Simd::update<false, HL>(state.data(), other.state.data());
     return *this;
   }
 };
 
+// Input buckets chosen by the square of a perspective's own king, seen from
+// its side of the board. With MIRROR_KING, positions where that king is on
+// files e-h are flipped horizontally first, so only files a-d of the layout
+// are read. One bucket without mirroring is the plain 768-input net
+inline constexpr bool MIRROR_KING = false;
+inline constexpr std::array<int, 64> KING_BUCKET_LAYOUT{};
+inline constexpr int KING_BUCKETS = std::ranges::max(KING_BUCKET_LAYOUT) + 1;
+
+// Recorded after the weights of bucketed nets: the bucket of every king
+// square, then 1 if the net mirrors and 0 otherwise. Nothing in the weights
+// says which layout they were trained with, and two layouts with the same
+// number of buckets give files of the same size
+struct LayoutTrailer {
+  std::array<int8_t, 64> buckets;
+  uint8_t mirrored;
+
+  static constexpr LayoutTrailer compiled() {
+    LayoutTrailer trailer{};
+
+    for (std::size_t i = 0; i < 64; ++i)
+      trailer.buckets[i] = KING_BUCKET_LAYOUT[i];
+
+    trailer.mirrored = MIRROR_KING;
+    return trailer;
+  }
+
+  constexpr bool operator==(const LayoutTrailer &) const = default;
+};
+
+static_assert(sizeof(LayoutTrailer) == 65);
+
+// The weights file is the hidden layer rows, 768 per bucket in bucket order,
+// then the biases, the output weights and the output bias, padded to 64 bytes,
+// then the layout trailer. The plain 768-input net may leave the trailer out
 class PerspectiveNetwork {
 public:
-  std::array<Accumulator, 768> hl_weights;
+  std::array<Accumulator, 768 * KING_BUCKETS> hl_weights;
   Accumulator hl_biases;
   std::array<Accumulator, 2> output_weights;
   int16_t output_bias;
 
+  // A net trained for a different layout would read as garbage, so the file
+  // has to record the layout this build was compiled with
   PerspectiveNetwork(const std::filesystem::path &path) {
+    static constexpr bool PLAIN = KING_BUCKETS == 1 && !MIRROR_KING;
+
+    std::string layout = std::format("{} king bucket(s) {} mirroring",
+                                     KING_BUCKETS,
+                                     MIRROR_KING ? "with" : "without");
+    std::error_code error;
+    std::uintmax_t file_size = std::filesystem::file_size(path, error);
+
+    if (error)
+      throw std::runtime_error(std::format("cannot read net {}: {}",
+                                           path.string(), error.message()));
+
+    bool has_trailer = file_size == sizeof(*this) + sizeof(LayoutTrailer);
+
+    if (!has_trailer && !(PLAIN && file_size == sizeof(*this)))
+      throw std::runtime_error(std::format(
+          "net {} is {} bytes, expected {}{} for {}", path.string(), file_size,
+          sizeof(*this) + sizeof(LayoutTrailer),
+          PLAIN ? std::format(" or {} without a layout trailer", sizeof(*this))
+                : "",
+          layout));
+
     std::ifstream in(path, std::ios::binary);
-    in.read((char *)this, sizeof(*this));
+    LayoutTrailer trailer = LayoutTrailer::compiled();
+
+    if (!in.read(reinterpret_cast<char *>(this), sizeof(*this)) ||
+        (has_trailer &&
+         !in.read(reinterpret_cast<char *>(&trailer), sizeof(trailer))))
+      throw std::runtime_error(
+          std::format("cannot read net {}", path.string()));
+
+    if (trailer != LayoutTrailer::compiled())
+      throw std::runtime_error(std::format(
+          "net {} was trained with a different king bucket layout than this "
+          "build, which has {}",
+          path.string(), layout));
+  }
+
+  // FNV-1a over the raw weights, identifies the net in saved TT files. The
+  // alignment padding after the output bias is left out
+  uint64_t hash() const {
+    uint64_t hash = 0xcbf29ce484222325;
+
+    for (char byte :
+         std::span(reinterpret_cast<const char *>(this),
+                   offsetof(PerspectiveNetwork, output_bias) +
+                       sizeof(output_bias))) {
+      hash ^= static_cast<uint8_t>(byte);
+      hash *= 0x100000001b3;
+    }
+
+    return hash;
   }
 
   const Accumulator &get_hl_line(int index) const { return hl_weights[index]; }
 
   const Accumulator &get_hl_biases() const { return hl_biases; }
 
-  static constexpr int activation(int16_t x) {
-    return std::clamp<int>(x, 0, QA);
-  };
-
-  constexpr int compute(const Accumulator &acc_stm,
-                        const Accumulator &acc_nstm) const {
+  // Clipped ReLU hidden layer into a single output
+  int compute(const Accumulator &acc_stm, const Accumulator &acc_nstm) const {
     auto compute_hl = [](const Accumulator &acc, const Accumulator &weights) {
-      return std::inner_product(
-          acc.state.begin(), acc.state.end(), weights.state.begin(), 0,
-          std::plus{}, [](int16_t x, int16_t y) { return activation(x) * y; });
+      return Simd::crelu_dot<HL>(acc.state.data(), weights.state.data(), QA);
     };
 
     return (compute_hl(acc_stm, output_weights[0]) +
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <algorithm>
+#include <charconv>
+#include <format>
+#include <fstream>
+#include <ranges>
+#include <string>
+#include <vector>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+// NUMA layout as reported by /sys. On single-node machines (or when /sys is
+// unavailable) every operation is a no-op
+class NumaTopology {
+  std::vector<std::vector<int>> node_cpus;
+
+  // Parses cpulist strings such as "0-15,32-47"
+  static std::vector<int> parse_cpulist(std::string_view cpulist) {
+    std::vector<int> cpus;
+
+    for (auto range : cpulist | std::views::split(',')) {
+      std::string_view str(range);
+      int first = 0, last;
+
+      auto [dash, ec] = std::from_chars(str.begin(), str.end(), first);
+      last = first;
+
+      if (ec == std::errc{} && dash != str.end() && *dash == '-')
+        std::from_chars(dash + 1, str.end(), last);
+
+      for (int cpu = first; cpu <= last; ++cpu)
+        cpus.push_back(cpu);
+    }
+
+    return cpus;
+  }
+
+public:
+  NumaTopology() {
+    for (int node = 0;; ++node) {
+      std::ifstream in(std::format("/sys/devices/system/node/node{}/cpulist",
+                                   node));
+      std::string cpulist;
+
+      if (!in || !std::getline(in, cpulist))
+        break;
+
+      node_cpus.push_back(parse_cpulist(cpulist));
+    }
+  }
+
+  std::size_t num_nodes() const {
+    return std::max<std::size_t>(node_cpus.size(), 1);
+  }
+
+  // Threads fill all cores of node 0 before moving on to node 1, and so on
+  std::size_t node_for_thread(std::size_t thread_id) const {
+    if (num_nodes() == 1)
+      return 0;
+
+    std::size_t total_cpus = 0;
+
+    for (const auto &cpus : node_cpus)
+      total_cpus += cpus.size();
+
+    thread_id %= std::max<std::size_t>(total_cpus, 1);
+
+    for (std::size_t node = 0; node < node_cpus.size(); ++node) {
+      if (thread_id < node_cpus[node].size())
+        return node;
+
+      thread_id -= node_cpus[node].size();
+    }
+
+    return 0;
+  }
+
+  // Restricts the calling thread to the cores of the given node
+  void bind_thread(std::size_t node) const {
+#ifdef __linux__
+    if (num_nodes() == 1)
+      return;
+
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+
+    for (int cpu : node_cpus[node])
+      CPU_SET(cpu, &cpu_set);
+
+    pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set);
+#endif
+  }
+};
@@ -1,18 +1,15 @@
 #include "perft.hpp"
 
-void splitperft(const Board &board, int depth) {
+void splitperft(Board board, int depth) {
   int64_t total = 0;
 
-  for (Move m : board.pseudolegal_moves()) {
-    Board copy = board;
-    copy.make_move(m);
+  for (Move m : board.legal_moves()) {
+    Board::Undo undo = board.make_move(m);
+    int64_t current = perft(board, depth - 1);
+    board.unmake_move(m, undo);
 
-    if (copy.is_legal()) {
-      int64_t current = perft(copy, depth - 1);
-
-      std::println("{} - {}", m.uci(), current);
-      total += current;
-    }
+    std::println("{} - {}", m.uci(), current);
+    total += current;
   }
 
   std::println("Total: {}", total);
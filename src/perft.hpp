@@ -2,21 +2,29 @@
 
 #include "board.hpp"
 
-constexpr int64_t perft(const Board &board, int depth) {
+template <Side::Literal STM> constexpr int64_t perft(Board &board, int depth) {
   if (depth == 0)
     return 1;
 
-  int64_t ans = 0;
+  MoveList moves = board.legal_moves<STM>();
+
+  if (depth == 1)
+    return moves.size();
 
-  for (Move m : board.pseudolegal_moves()) {
-    Board copy = board;
-    copy.make_move(m);
+  int64_t ans = 0;
 
-    if (copy.is_legal())
-      ans += perft(copy, depth - 1);
+  for (Move m : moves) {
+    Board::Undo undo = board.make_move<STM>(m);
+    ans += perft<~STM>(board, depth - 1);
+    board.unmake_move<STM>(m, undo);
   }
 
   return ans;
 }
 
-void splitperft(const Board &board, int depth);
+constexpr int64_t perft(Board &board, int depth) {
+  return board.stm == Sides::WHITE ? perft<Sides::WHITE>(board, depth)
+                                   : perft<Sides::BLACK>(board, depth);
+}
+
+void splitperft(Board board, int depth);
@@ -0,0 +1,109 @@
+#pragma once
+
+#include "bitboard.hpp"
+#include "piece.hpp"
+
+#ifdef USE_PEXT
+#include <immintrin.h>
+#endif
+
+// Follows each ray of a bishop or rook up to and including the first blocker.
+// Slow, only meant for building and checking lookup tables
+constexpr Bitboard sliding_attacks(Piece p, Square square, Bitboard occupied) {
+  static constexpr std::array<Direction, 4> bishop_directions{
+      Direction::NORTH_WEST, Direction::NORTH_EAST, Direction::SOUTH_WEST,
+      Direction::SOUTH_EAST};
+  static constexpr std::array<Direction, 4> rook_directions{
+      Direction::NORTH, Direction::EAST, Direction::SOUTH, Direction::WEST};
+
+  Bitboard attacks;
+
+  for (Direction d :
+       p == Pieces::BISHOP ? bishop_directions : rook_directions) {
+    Bitboard bb(square);
+
+    while ((bb = bb.shift(d))) {
+      attacks |= bb;
+
+      if (bb & occupied)
+        break;
+    }
+  }
+
+  return attacks;
+}
+
+// The squares whose occupancy can change the attacks of a slider: its empty
+// board rays without the last square of each
+constexpr Bitboard relevant_occupancy(Piece p, Square square) {
+  Bitboard rank_edges = (Bitboards::Rank1 | Bitboards::Rank8) &
+                        ~(Bitboards::Rank1 << 8 * square.rank()),
+           file_edges = (Bitboards::FileA | Bitboards::FileH) &
+                        ~(Bitboards::FileA << square.file());
+
+  return sliding_attacks(p, square, Bitboard()) & ~(rank_edges | file_edges);
+}
+
+#ifdef USE_PEXT
+// Every square gets a dense block of 2^popcount(mask) attack sets, indexed
+// by PEXT of the occupancy with the mask. With USE_PDEP each set is stored as
+// the PEXT of itself with the empty board rays and expanded again by PDEP,
+// which fits in 16 bits and cuts the tables from 841 KB to 210 KB
+template <Piece::Literal P> struct PextTable {
+  static constexpr int SIZE = P == Pieces::BISHOP ? 5248 : 102400;
+
+  struct Entry {
+    uint64_t mask, rays;
+    int offset;
+  };
+
+  Squares::Array<Entry> entries;
+#ifdef USE_PDEP
+  std::array<uint16_t, SIZE> attacks;
+#else
+  std::array<Bitboard, SIZE> attacks;
+#endif
+};
+
+// Built at startup, the rook table is too large for constant evaluation
+template <Piece::Literal P>
+inline const PextTable<P> pext_table = []() {
+  PextTable<P> table{};
+  int offset = 0;
+
+  for (Square square : Squares::ALL) {
+    uint64_t mask = relevant_occupancy(P, square).raw(),
+             rays = sliding_attacks(P, square, Bitboard()).raw(), subset = 0;
+
+    table.entries[square] = {mask, rays, offset};
+
+    // The carry-rippler visits the subsets of mask in the same order as their
+    // PEXT indices
+    do {
+      Bitboard attacks = sliding_attacks(P, square, subset);
+
+#ifdef USE_PDEP
+      table.attacks[offset++] = _pext_u64(attacks.raw(), rays);
+#else
+      table.attacks[offset++] = attacks;
+#endif
+      subset = (subset - mask) & mask;
+    } while (subset);
+  }
+
+  return table;
+}();
+
+template <Piece::Literal P>
+inline Bitboard pext_attacks(Square square, Bitboard occupied) {
+  auto [mask, rays, offset] = pext_table<P>.entries[square];
+  auto attacks =
+      pext_table<P>.attacks[offset + _pext_u64(occupied.raw(), mask)];
+
+#ifdef USE_PDEP
+  return _pdep_u64(attacks, rays);
+#else
+  return attacks;
+#endif
+}
+#endif
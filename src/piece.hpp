@@ -5,7 +5,15 @@
 
 class Piece {
 public:
-  enum class Literal { PAWN, KNIGHT, BISHOP, ROOK, QUEEN, KING, NONE };
+  enum class Literal : uint8_t {
+    PAWN,
+    KNIGHT,
+    BISHOP,
+    ROOK,
+    QUEEN,
+    KING,
+    NONE
+  };
 
   constexpr Piece() : Piece(Literal::NONE) {}
 
@@ -2,19 +2,27 @@
 
 #include "eval.hpp"
 #include "move.hpp"
+#include "movepicker.hpp"
 #include "ttable.hpp"
 #include "tunable_params.hpp"
 #include <algorithm>
+#include <atomic>
 #include <chrono>
 #include <cmath>
 #include <functional>
+#include <memory>
+#include <thread>
+
+class SearchThread {
+  TTable &ttable;
+  const std::atomic<bool> &stop_flag;
+  std::atomic<int64_t> &total_nodes;
 
-class Searcher {
-  TTable ttable{};
   std::vector<uint64_t> hashes{};
   Squares::Array<Squares::Array<int>> history{};
 
-  int64_t nodes_searched, hard_node_limit;
+  std::atomic<int64_t> nodes_searched;
+  int64_t hard_node_limit;
   bool cancel_search;
 
   std::chrono::system_clock::time_point start, deadline;
@@ -23,77 +31,40 @@ class Searcher {
 
   std::array<std::array<Move, 2>, MAX_PLY> killer_moves;
 
+  // Each thread adds its nodes to the shared total in batches, so the node
+  // limits see every thread's work and are exact with a single one
+  void count_node() {
+    int64_t nodes = nodes_searched.load(std::memory_order_relaxed) + 1;
+    nodes_searched.store(nodes, std::memory_order_relaxed);
+
+    if (nodes % TIME_CHECK_FREQUENCY == 0)
+      total_nodes.fetch_add(TIME_CHECK_FREQUENCY, std::memory_order_relaxed);
+  }
+
+  int64_t all_nodes() const {
+    return total_nodes.load(std::memory_order_relaxed) +
+           nodes_searched.load(std::memory_order_relaxed) %
+               TIME_CHECK_FREQUENCY;
+  }
+
   bool check_hard_limit() {
     return cancel_search =
-               (cancel_search || nodes_searched >= hard_node_limit ||
+               (cancel_search || stop_flag.load(std::memory_order_relaxed) ||
+                all_nodes() >= hard_node_limit ||
                 (nodes_searched % TIME_CHECK_FREQUENCY == 0 &&
                  std::chrono::system_clock::now() >= deadline));
   }
 
-  template <bool QSearch = false, typename BoardType>
-    requires std::derived_from<BoardType, Board>
-  constexpr MoveList sorted_moves(const BoardType &board, int ply,
-                                  Move tt_move) const {
-    static constexpr EnumArray<Piece::Literal, Pieces::Array<int>, 7>
-        mvv_lva_lookup{
-            // clang-format off
-            15, 14, 13, 12, 11, 10,
-            25, 24, 23, 22, 21, 20,
-            35, 34, 33, 32, 31, 30,
-            45, 44, 43, 42, 41, 40,
-            55, 54, 53, 52, 51, 50,
-            65, 64, 63, 62, 61, 60,
-             0,  0,  0,  0,  0,  0,
-            // clang-format on
-        };
-
-    MoveList moves = board.pseudolegal_moves();
-
-    if constexpr (QSearch)
-      moves.resize(std::remove_if(moves.begin(), moves.end(),
-                                  [](Move m) { return !m.is_capture(); }) -
-                   moves.begin());
-
-    std::array<ScoredMove, MAX_MOVES> scored_moves;
-
-    std::ranges::transform(moves, scored_moves.begin(), [&](Move move) {
-      static constexpr int CAPTURE_BASE = 1'000'000'000,
-                           KILLER_SCORE = CAPTURE_BASE;
-      uint32_t score;
-
-      if (move == tt_move)
-        score = std::numeric_limits<uint32_t>::max();
-      else if (move.is_capture())
-        score = CAPTURE_BASE +
-                mvv_lva_lookup[board.square_to_piece[move.to()]]
-                              [board.square_to_piece[move.from()]];
-      else if (std::ranges::contains(killer_moves[ply], move))
-        score = KILLER_SCORE;
-      else
-        score = history[move.from()][move.to()];
-
-      return ScoredMove(score, move);
-    });
-
-    std::stable_sort(scored_moves.begin(), scored_moves.begin() + moves.size(),
-                     std::greater<>{});
-
-    std::transform(scored_moves.begin(), scored_moves.begin() + moves.size(),
-                   moves.begin(),
-                   [](ScoredMove scored_move) { return scored_move; });
-
-    return moves;
-  }
-
-  template <bool PV, typename BoardType>
+  template <bool PV, Side::Literal STM, typename BoardType>
     requires std::derived_from<BoardType, Board>
-  int qsearch(const BoardType &board, int ply, int alpha, int beta) {
+  int qsearch(BoardType &board, int ply, int alpha, int beta) {
     if (check_hard_limit())
       return 0;
 
-    ++nodes_searched;
+    count_node();
 
-    int stand_pat = board.eval();
+    std::optional<TTNode> node = ttable.lookup(board.zobrist, ply);
+    int stand_pat = node ? node->static_eval : board.eval();
 
     if (stand_pat >= beta)
       return stand_pat;
@@ -103,8 +74,6 @@ class Searcher {
 
     alpha = std::max(alpha, stand_pat);
 
-    std::optional<TTNode> node = ttable.lookup(board.zobrist, ply);
-
     if (!PV && node.has_value() &&
         (node->type == TTNode::Type::EXACT ||
          (node->type == TTNode::Type::UPPERBOUND && node->value <= alpha) ||
@@ -117,52 +86,54 @@ class Searcher {
 
     hashes.push_back(board.zobrist);
 
-    for (Move move :
-         sorted_moves<true>(board, ply, node ? node->best_move : Move{})) {
-      BoardType copy = board;
-      copy.make_move(move);
+    MovePicker<STM> picker(board, node ? node->best_move : Move{},
+                           killer_moves[ply], history, false, true);
 
-      if (copy.is_legal()) {
-        int value = -qsearch<PV>(copy, ply + 1, -beta, -alpha);
+    for (Move move; (move = picker.next()) != Move{};) {
+      ttable.prefetch(board.key_after(move));
 
-        if (cancel_search) {
-          hashes.pop_back();
-          return 0;
-        }
+      Board::Undo undo = board.template make_move<STM>(move);
+      int value = -qsearch<PV, ~STM>(board, ply + 1, -beta, -alpha);
+      board.template unmake_move<STM>(move, undo);
 
-        best_value = std::max(best_value, value);
+      if (cancel_search) {
+        hashes.pop_back();
+        return 0;
+      }
 
-        if (value > alpha) {
-          alpha = value;
-          best_move = move;
-          tt_type = TTNode::Type::EXACT;
-        }
+      best_value = std::max(best_value, value);
 
-        if (value >= beta) {
-          tt_type = TTNode::Type::LOWERBOUND;
-          break;
-        }
+      if (value > alpha) {
+        alpha = value;
+        best_move = move;
+        tt_type = TTNode::Type::EXACT;
+      }
+
+      if (value >= beta) {
+        tt_type = TTNode::Type::LOWERBOUND;
+        break;
       }
     }
 
     hashes.pop_back();
 
-    ttable.insert(board.zobrist, best_move, best_value, 0, tt_type, ply);
+    ttable.insert(board.zobrist, best_move, best_value, stand_pat, 0, tt_type,
+                  ply);
 
     return best_value;
   }
 
-  template <bool PV, typename BoardType>
+  template <bool PV, Side::Literal STM, typename BoardType>
     requires std::derived_from<BoardType, Board>
-  int negamax(const BoardType &board, int depth, int ply = 0, int alpha = -INF,
+  int negamax(BoardType &board, int depth, int ply = 0, int alpha = -INF,
               int beta = INF) {
     if (check_hard_limit())
       return 0;
 
     if (depth == 0)
-      return qsearch<PV>(board, ply, alpha, beta);
+      return qsearch<PV, STM>(board, ply, alpha, beta);
 
-    ++nodes_searched;
+    count_node();
 
     if (ply > 0 &&
         (std::ranges::contains(hashes, board.zobrist) || board.is_draw()))
@@ -170,7 +141,7 @@ class Searcher {
 
     std::optional<TTNode> node = ttable.lookup(board.zobrist, ply);
     const bool is_check = board.is_check();
-    int static_eval = board.eval();
+    int static_eval = node ? node->static_eval : board.eval();
 
     if constexpr (!PV) {
       if (node.has_value() && node->depth >= depth &&
@@ -184,16 +155,15 @@ class Searcher {
           static_eval >= beta + depth * RFP_SCALE)
         return static_eval;
 
-      // NMP
-      if (!is_check || (board.side_occupancy[board.stm] !=
-                        (board.pieces[board.stm][Pieces::PAWN] |
-                         board.pieces[board.stm][Pieces::KING]))) {
-        BoardType copy = board;
-        copy.make_null_move();
-
-        int nmp_value =
-            -negamax<false>(copy, std::max(depth - NMP_DEPTH_REDUCTION, 0),
-                            ply + 1, -beta, -(beta - 1));
+      // NMP. Never in check, or the opponent could capture the king
+      if (!is_check &&
+          board.side_occupancy[STM] != (board.pieces(STM, Pieces::PAWN) |
+                                        board.pieces(STM, Pieces::KING))) {
+        Board::Undo undo = board.make_null_move();
+        int nmp_value = -negamax<false, ~STM>(
+            board, std::max(depth - NMP_DEPTH_REDUCTION, 0), ply + 1, -beta,
+            -(beta - 1));
+        board.unmake_null_move(undo);
 
         if (nmp_value >= beta)
           return nmp_value;
@@ -206,102 +176,102 @@ class Searcher {
 
     hashes.push_back(board.zobrist);
 
-    for (auto [i, move] : std::views::enumerate(
-             sorted_moves(board, ply, node ? node->best_move : Move()))) {
-      BoardType copy = board;
-      copy.make_move(move);
+    MovePicker<STM> picker(board, node ? node->best_move : Move{},
+                           killer_moves[ply], history, is_check);
+    Move move;
 
+    for (long i = 0; (move = picker.next()) != Move{}; ++i) {
+      ttable.prefetch(board.key_after(move));
+
+      Board::Undo undo = board.template make_move<STM>(move);
       int value = -INF;
 
-      if (copy.is_legal()) {
-        // LMR
-        if (depth >= LMR_MIN_DEPTH && i > (ply == 0) && !is_check) {
-          int reduction = LMR_A + LMR_B * std::log(depth) *
-                                      std::log(std::max(i + 1, 1L)),
-              reduced = depth - 1 - reduction;
+      // LMR
+      if (depth >= LMR_MIN_DEPTH && i > (ply == 0) && !is_check) {
+        int reduction = LMR_A + LMR_B * std::log(depth) *
+                                    std::log(std::max(i + 1, 1L)),
+            reduced = depth - 1 - reduction;
+
+        value = -negamax<false, ~STM>(board, reduced, ply + 1, -alpha - 1,
+                                      -alpha);
+
+        if (value > alpha && reduced < depth)
+          value = -negamax<false, ~STM>(board, depth - 1, ply + 1, -alpha - 1,
+                                        -alpha);
+      } else if (!PV || i > 0) {
+        value = -negamax<false, ~STM>(board, depth - 1, ply + 1, -alpha - 1,
+                                      -alpha);
+      }
 
-          value = -negamax<false>(copy, reduced, ply + 1, -alpha - 1, -alpha);
+      if (PV && (i == 0 || value > alpha))
+        value = -negamax<true, ~STM>(board, depth - 1, ply + 1, -beta, -alpha);
 
-          if (value > alpha && reduced < depth)
-            value =
-                -negamax<false>(copy, depth - 1, ply + 1, -alpha - 1, -alpha);
-        } else if (!PV || i > 0) {
-          value = -negamax<false>(copy, depth - 1, ply + 1, -alpha - 1, -alpha);
-        }
+      board.template unmake_move<STM>(move, undo);
 
-        if (PV && (i == 0 || value > alpha))
-          value = -negamax<true>(copy, depth - 1, ply + 1, -beta, -alpha);
+      if (cancel_search) {
+        hashes.pop_back();
+        return 0;
+      }
 
-        if (cancel_search) {
-          hashes.pop_back();
-          return 0;
-        }
+      best_value = std::max(best_value, value);
 
-        best_value = std::max(best_value, value);
+      if (value > alpha) {
+        alpha = value;
+        best_move = move;
+        tt_type = TTNode::Type::EXACT;
+      }
 
-        if (value > alpha) {
-          alpha = value;
-          best_move = move;
-          tt_type = TTNode::Type::EXACT;
+      if (value >= beta) {
+        if (ply < MAX_PLY && move.is_quiet()) {
+          if (move == killer_moves[ply][0])
+            killer_moves[ply][1] = move;
+          else
+            killer_moves[ply][0] = move;
         }
 
-        if (value >= beta) {
-          if (ply < MAX_PLY && move.is_quiet()) {
-            if (move == killer_moves[ply][0])
-              killer_moves[ply][1] = move;
-            else
-              killer_moves[ply][0] = move;
-          }
-
-          history[move.from()][move.to()] += depth * depth;
-          tt_type = TTNode::Type::LOWERBOUND;
-          break;
-        }
+        history[move.from()][move.to()] += depth * depth;
+        tt_type = TTNode::Type::LOWERBOUND;
+        break;
       }
     }
 
     hashes.pop_back();
 
     if (best_value == -INF)
-      best_value = board.is_check() ? ply - CHECKMATE : 0;
+      best_value = is_check ? ply - CHECKMATE : 0;
 
     if (ply == 0 && best_move != Move{})
       best_root_move = best_move;
 
-    ttable.insert(board.zobrist, best_move, best_value, depth, tt_type, ply);
+    ttable.insert(board.zobrist, best_move, best_value, static_eval, depth,
+                  tt_type, ply);
 
     return best_value;
   }
 
 public:
-  constexpr void stop() { cancel_search = true; }
+  SearchThread(TTable &ttable, const std::atomic<bool> &stop_flag,
+               std::atomic<int64_t> &total_nodes)
+      : ttable(ttable), stop_flag(stop_flag), total_nodes(total_nodes) {}
 
-  constexpr void resize_ttable(std::size_t new_size) {
-    ttable.resize(new_size);
+  int64_t nodes() const {
+    return nodes_searched.load(std::memory_order_relaxed);
   }
 
-  constexpr void clear() {
-    history = {};
-    hashes.clear();
-    ttable = {};
-  }
-
-  constexpr void clear_hashes() { hashes.clear(); }
+  void clear() { history = {}; }
 
-  constexpr bool check_threefold(uint64_t hash) const {
-    return std::ranges::count(hashes, hash) >= 3;
+  void set_hashes(const std::vector<uint64_t> &game_hashes) {
+    hashes = game_hashes;
   }
 
-  constexpr void add_hash(uint64_t hash) { hashes.push_back(hash); }
-
-  template <bool INFO = true, typename BoardType>
+  template <typename BoardType, typename Reporter>
     requires std::derived_from<BoardType, Board>
-  constexpr std::pair<Move, int16_t>
-  search(const BoardType &board,
+  std::pair<Move, int16_t>
+  search(BoardType board,
          std::optional<std::chrono::system_clock::duration> duration_opt,
          std::optional<int64_t> soft_node_limit_opt,
          std::optional<int64_t> hard_node_limit_opt,
-         std::optional<int64_t> max_depth_opt) {
+         std::optional<int64_t> max_depth_opt, Reporter &&report) {
     start = std::chrono::system_clock::now();
     deadline = start + duration_opt.value_or(std::chrono::years(1));
     hard_node_limit =
@@ -309,8 +279,8 @@ public:
 
     int64_t soft_node_limit = soft_node_limit_opt.value_or(
                 std::numeric_limits<int64_t>::max()),
-            max_depth =
-                max_depth_opt.value_or(std::numeric_limits<int64_t>::max());
+            max_depth = std::min<int64_t>(max_depth_opt.value_or(MAX_DEPTH),
+                                          MAX_DEPTH);
 
     nodes_searched = 0;
     cancel_search = false;
@@ -320,7 +290,7 @@ public:
 
     int best_root_value = -INF;
 
-    for (int depth = 1; nodes_searched <= soft_node_limit && depth <= max_depth;
+    for (int depth = 1; all_nodes() <= soft_node_limit && depth <= max_depth;
          ++depth) {
       int alpha = -INF, beta = INF, delta = ASP_DELTA;
 
@@ -333,7 +303,12 @@ public:
       }
 
       while (true) {
-        int current = negamax<true>(board, depth, 0, alpha, beta);
+        // The only branch on the side to move, every node below knows it at
+        // compile time
+        int current =
+            board.stm == Sides::WHITE
+                ? negamax<true, Sides::WHITE>(board, depth, 0, alpha, beta)
+                : negamax<true, Sides::BLACK>(board, depth, 0, alpha, beta);
 
         if (cancel_search)
           break;
@@ -353,30 +328,199 @@ public:
       if (cancel_search)
         break;
 
-      std::optional<int> moves_to_mate;
-
-      if (best_root_value <= -CHECKMATE_THRESHOLD)
-        moves_to_mate = -(CHECKMATE + best_root_value + 1) / 2;
-      else if (best_root_value >= CHECKMATE_THRESHOLD)
-        moves_to_mate = (CHECKMATE - best_root_value + 1) / 2;
-
-      if (INFO) {
-        auto time_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
-                           std::chrono::system_clock::now() - start)
-                           .count();
-
-        std::println(
-            "info depth {} nodes {} nps {} hashfull {} score {} time {} pv {}",
-            depth, nodes_searched,
-            static_cast<int>(1000 * nodes_searched / (time_ms + 1)),
-            ttable.hashfull(),
-            moves_to_mate.has_value()
-                ? std::string("mate ") + std::to_string(*moves_to_mate)
-                : std::string("cp ") + std::to_string(best_root_value),
-            time_ms, best_root_move.uci());
-      }
+      report(depth, best_root_value, best_root_move);
     }
 
     return {best_root_move, best_root_value};
   }
 };
+
+class Searcher {
+  TTable ttable{};
+  std::atomic<bool> stop_flag;
+  std::atomic<int64_t> total_nodes;
+  std::vector<std::unique_ptr<SearchThread>> threads;
+  std::vector<uint64_t> hashes{};
+
+  NumaTopology numa;
+  bool numa_bind = false;
+  std::vector<std::unique_ptr<PerspectiveNetwork>> networks;
+  const PerspectiveNetwork *networks_source = nullptr;
+
+  const NumaTopology *numa_policy() const {
+    return numa_bind && numa.num_nodes() > 1 ? &numa : nullptr;
+  }
+
+  // Makes one copy of the network per node, each allocated by a thread bound
+  // to that node so that its pages end up in local memory
+  void replicate_network(const PerspectiveNetwork &net) {
+    if (networks_source == &net)
+      return;
+
+    networks.resize(numa.num_nodes());
+
+    std::vector<std::jthread> replicators;
+
+    for (std::size_t node = 0; node < networks.size(); ++node)
+      replicators.emplace_back([this, &net, node]() {
+        numa.bind_thread(node);
+        networks[node] = std::make_unique<PerspectiveNetwork>(net);
+      });
+
+    networks_source = &net;
+  }
+
+  template <typename BoardType>
+  BoardType thread_board(const BoardType &board, std::size_t thread_id) const {
+    BoardType local = board;
+
+    if constexpr (requires { local.net; })
+      if (numa_policy())
+        local.net = *networks[numa.node_for_thread(thread_id)];
+
+    return local;
+  }
+
+  void print_info(std::chrono::system_clock::time_point start, int depth,
+                  int value, Move best_move) const {
+    std::optional<int> moves_to_mate;
+
+    if (value <= -CHECKMATE_THRESHOLD)
+      moves_to_mate = -(CHECKMATE + value + 1) / 2;
+    else if (value >= CHECKMATE_THRESHOLD)
+      moves_to_mate = (CHECKMATE - value + 1) / 2;
+
+    auto time_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+                       std::chrono::system_clock::now() - start)
+                       .count();
+    int64_t nodes = this->nodes();
+
+    std::println(
+        "info depth {} nodes {} nps {} hashfull {} score {} time {} pv {}",
+        depth, nodes, static_cast<int>(1000 * nodes / (time_ms + 1)),
+        ttable.hashfull(),
+        moves_to_mate.has_value()
+            ? std::string("mate ") + std::to_string(*moves_to_mate)
+            : std::string("cp ") + std::to_string(value),
+        time_ms, best_move.uci());
+  }
+
+public:
+  Searcher() { set_threads(1); }
+
+  // search always runs threads[0], so there is at least one whatever the
+  // option parsed to
+  void set_threads(std::size_t num_threads) {
+    num_threads = std::max<std::size_t>(num_threads, 1);
+    threads.clear();
+
+    for (std::size_t i = 0; i < num_threads; ++i)
+      threads.push_back(
+          std::make_unique<SearchThread>(ttable, stop_flag, total_nodes));
+  }
+
+  void stop() { stop_flag = true; }
+
+  void set_numa_bind(bool enabled) { numa_bind = enabled; }
+
+  void resize_ttable(std::size_t megabytes) { ttable.resize(megabytes); }
+
+  // Done on isready so that the first search after a Hash change does not
+  // pay for allocating and zeroing the table
+  void allocate_ttable() { ttable.allocate(threads.size(), numa_policy()); }
+
+  bool save_ttable(const std::filesystem::path &path, uint64_t net_hash) const {
+    return ttable.save(path, net_hash);
+  }
+
+  bool load_ttable(const std::filesystem::path &path, uint64_t net_hash) {
+    return ttable.load(path, net_hash);
+  }
+
+  void clear() {
+    for (auto &thread : threads)
+      thread->clear();
+
+    hashes.clear();
+    ttable.clear(threads.size(), numa_policy());
+  }
+
+  constexpr void clear_hashes() { hashes.clear(); }
+
+  constexpr bool check_threefold(uint64_t hash) const {
+    return std::ranges::count(hashes, hash) >= 3;
+  }
+
+  constexpr void add_hash(uint64_t hash) { hashes.push_back(hash); }
+
+  int64_t nodes() const {
+    int64_t nodes = 0;
+
+    for (const auto &thread : threads)
+      nodes += thread->nodes();
+
+    return nodes;
+  }
+
+  // Lazy SMP: every helper searches the same root on its own board copy and
+  // communicates with the main thread only through the shared TT
+  template <bool INFO = true, typename BoardType>
+    requires std::derived_from<BoardType, Board>
+  std::pair<Move, int16_t>
+  search(const BoardType &board,
+         std::optional<std::chrono::system_clock::duration> duration_opt,
+         std::optional<int64_t> soft_node_limit_opt,
+         std::optional<int64_t> hard_node_limit_opt,
+         std::optional<int64_t> max_depth_opt) {
+    auto start = std::chrono::system_clock::now();
+    stop_flag = false;
+    total_nodes = 0;
+    allocate_ttable();
+    ttable.new_search();
+
+    if constexpr (requires { board.net; })
+      if (numa_policy())
+        replicate_network(board.net);
+
+    for (auto &thread : threads)
+      thread->set_hashes(hashes);
+
+    std::vector<std::jthread> helpers;
+
+    for (std::size_t i = 1; i < threads.size(); ++i)
+      helpers.emplace_back([this, i, &board, max_depth_opt]() {
+        if (numa_policy())
+          numa.bind_thread(numa.node_for_thread(i));
+
+        threads[i]->search(thread_board(board, i), std::nullopt, std::nullopt,
+                           std::nullopt, max_depth_opt, [](int, int, Move) {});
+      });
+
+    std::pair<Move, int16_t> result;
+
+    auto main_search = [&]() {
+      if (numa_policy())
+        numa.bind_thread(numa.node_for_thread(0));
+
+      result = threads[0]->search(
+          thread_board(board, 0), duration_opt, soft_node_limit_opt,
+          hard_node_limit_opt, max_depth_opt,
+          [&](int depth, int value, Move best_move) {
+            if constexpr (INFO)
+              print_info(start, depth, value, best_move);
+          });
+    };
+
+    // Binding is only ever applied to threads the searcher owns, so with a
+    // NUMA policy the main search gets one too instead of pinning the caller,
+    // which is the UCI thread during bench and datagen
+    if (numa_policy())
+      std::jthread(main_search).join();
+    else
+      main_search();
+
+    stop_flag = true;
+
+    return result;
+  }
+};
@@ -1,10 +1,11 @@
 #pragma once
 
 #include "enumarray.hpp"
+#include <cstdint>
 
 class Side {
 public:
-  enum class Literal { WHITE, BLACK };
+  enum class Literal : uint8_t { WHITE, BLACK };
 
   constexpr Side() : Side(Literal::WHITE) {}
 
@@ -20,6 +21,12 @@ private:
   Literal data;
 };
 
+// Lets template code flip a side given as a Side::Literal parameter
+constexpr Side::Literal operator~(Side::Literal side) {
+  return side == Side::Literal::WHITE ? Side::Literal::BLACK
+                                      : Side::Literal::WHITE;
+}
+
 namespace Sides {
 using enum Side::Literal;
 
@@ -0,0 +1,228 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <numeric>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define SIMD_X86
+#include <immintrin.h>
+#endif
+
+// Vector kernels for the network. Each one is compiled for AVX-512, AVX2 and
+// plain C++, and the widest one the CPU supports is picked at startup, so a
+// single binary runs everywhere. Pointers into accumulators and weight rows
+// must be 64-byte aligned
+namespace Simd {
+enum class Level { SCALAR, AVX2, AVX512 };
+
+inline bool supported(Level level) {
+#ifdef SIMD_X86
+  __builtin_cpu_init();
+
+  switch (level) {
+  case Level::AVX512:
+    return __builtin_cpu_supports("avx512bw");
+  case Level::AVX2:
+    return __builtin_cpu_supports("avx2");
+  default:
+    return true;
+  }
+#else
+  return level == Level::SCALAR;
+#endif
+}
+
+inline const Level level = supported(Level::AVX512) ? Level::AVX512
+                           : supported(Level::AVX2) ? Level::AVX2
+                                                    : Level::SCALAR;
+
+constexpr const char *level_name(Level level) {
+  switch (level) {
+  case Level::AVX512:
+    return "avx512";
+  case Level::AVX2:
+    return "avx2";
+  default:
+    return "scalar";
+  }
+}
+
+#ifdef SIMD_X86
+template <bool ADD, std::size_t N>
+__attribute__((target("avx512f,avx512bw"))) void
+update_avx512(int16_t *acc, const int16_t *row) {
+  for (std::size_t i = 0; i < N; i += 32) {
+    __m512i a = _mm512_load_si512(acc + i), r = _mm512_load_si512(row + i);
+    _mm512_store_si512(acc + i,
+                       ADD ? _mm512_add_epi16(a, r) : _mm512_sub_epi16(a, r));
+  }
+}
+
+template <bool ADD, std::size_t N>
+__attribute__((target("avx2"))) void update_avx2(int16_t *acc,
+                                                 const int16_t *row) {
+  for (std::size_t i = 0; i < N; i += 16) {
+    __m256i a = _mm256_load_si256(reinterpret_cast<__m256i *>(acc + i)),
+            r = _mm256_load_si256(reinterpret_cast<const __m256i *>(row + i));
+    _mm256_store_si256(reinterpret_cast<__m256i *>(acc + i),
+                       ADD ? _mm256_add_epi16(a, r) : _mm256_sub_epi16(a, r));
+  }
+}
+
+// One load and one store of each accumulator vector however many rows the
+// move touches
+template <std::size_t N, std::size_t ADDS, std::size_t SUBS>
+__attribute__((target("avx512f,avx512bw"))) void
+add_sub_avx512(int16_t *out, const int16_t *in,
+               const std::array<const int16_t *, ADDS> &added,
+               const std::array<const int16_t *, SUBS> &removed) {
+  for (std::size_t i = 0; i < N; i += 32) {
+    __m512i v = _mm512_load_si512(in + i);
+
+    for (const int16_t *row : added)
+      v = _mm512_add_epi16(v, _mm512_load_si512(row + i));
+
+    for (const int16_t *row : removed)
+      v = _mm512_sub_epi16(v, _mm512_load_si512(row + i));
+
+    _mm512_store_si512(out + i, v);
+  }
+}
+
+template <std::size_t N, std::size_t ADDS, std::size_t SUBS>
+__attribute__((target("avx2"))) void
+add_sub_avx2(int16_t *out, const int16_t *in,
+             const std::array<const int16_t *, ADDS> &added,
+             const std::array<const int16_t *, SUBS> &removed) {
+  for (std::size_t i = 0; i < N; i += 16) {
+    __m256i v = _mm256_load_si256(reinterpret_cast<const __m256i *>(in + i));
+
+    for (const int16_t *row : added)
+      v = _mm256_add_epi16(
+          v, _mm256_load_si256(reinterpret_cast<const __m256i *>(row + i)));
+
+    for (const int16_t *row : removed)
+      v = _mm256_sub_epi16(
+          v, _mm256_load_si256(reinterpret_cast<const __m256i *>(row + i)));
+
+    _mm256_store_si256(reinterpret_cast<__m256i *>(out + i), v);
+  }
+}
+
+// Products of the clamped inputs and the weights fit in 16 x 16 -> 32 bit
+// madd, and the int32 sums are exact, so the order of the reduction does not
+// change the result
+template <std::size_t N>
+__attribute__((target("avx512f,avx512bw"))) int
+crelu_dot_avx512(const int16_t *input, const int16_t *weights, int16_t max) {
+  const __m512i zero = _mm512_setzero_si512(), ceiling = _mm512_set1_epi16(max);
+  __m512i sum = _mm512_setzero_si512();
+
+  for (std::size_t i = 0; i < N; i += 32) {
+    __m512i clamped = _mm512_min_epi16(
+        _mm512_max_epi16(_mm512_load_si512(input + i), zero), ceiling);
+    sum = _mm512_add_epi32(
+        sum, _mm512_madd_epi16(clamped, _mm512_load_si512(weights + i)));
+  }
+
+  return _mm512_reduce_add_epi32(sum);
+}
+
+template <std::size_t N>
+__attribute__((target("avx2"))) int
+crelu_dot_avx2(const int16_t *input, const int16_t *weights, int16_t max) {
+  const __m256i zero = _mm256_setzero_si256(), ceiling = _mm256_set1_epi16(max);
+  __m256i sum = _mm256_setzero_si256();
+  auto x = reinterpret_cast<const __m256i *>(input),
+       w = reinterpret_cast<const __m256i *>(weights);
+
+  for (std::size_t i = 0; i < N / 16; ++i) {
+    __m256i clamped = _mm256_min_epi16(
+        _mm256_max_epi16(_mm256_load_si256(x + i), zero), ceiling);
+    sum = _mm256_add_epi32(
+        sum, _mm256_madd_epi16(clamped, _mm256_load_si256(w + i)));
+  }
+
+  __m128i half = _mm_add_epi32(_mm256_castsi256_si128(sum),
+                               _mm256_extracti128_si256(sum, 1));
+  half = _mm_add_epi32(half, _mm_unpackhi_epi64(half, half));
+  half = _mm_add_epi32(half, _mm_shuffle_epi32(half, 0b01));
+
+  return _mm_cvtsi128_si32(half);
+}
+#endif
+
+// acc[i] += row[i], or -= without ADD, for the N entries of a row. N must be
+// a multiple of 32
+template <bool ADD, std::size_t N>
+inline void update(int16_t *acc, const int16_t *row) {
+  static_assert(N % 32 == 0);
+
+#ifdef SIMD_X86
+  if (level == Level::AVX512)
+    return update_avx512<ADD, N>(acc, row);
+
+  if (level == Level::AVX2)
+    return update_avx2<ADD, N>(acc, row);
+#endif
+
+  if constexpr (ADD)
+    std::transform(acc, acc + N, row, acc, std::plus<int16_t>{});
+  else
+    std::transform(acc, acc + N, row, acc, std::minus<int16_t>{});
+}
+
+// out = in + the added rows - the removed rows, in a single pass. out may be
+// in. N must be a multiple of 32
+template <std::size_t N, std::size_t ADDS, std::size_t SUBS>
+inline void add_sub(int16_t *out, const int16_t *in,
+                    const std::array<const int16_t *, ADDS> &added,
+                    const std::array<const int16_t *, SUBS> &removed) {
+  static_assert(N % 32 == 0);
+
+#ifdef SIMD_X86
+  if (level == Level::AVX512)
+    return add_sub_avx512<N>(out, in, added, removed);
+
+  if (level == Level::AVX2)
+    return add_sub_avx2<N>(out, in, added, removed);
+#endif
+
+  for (std::size_t i = 0; i < N; ++i) {
+    int16_t v = in[i];
+
+    for (const int16_t *row : added)
+      v += row[i];
+
+    for (const int16_t *row : removed)
+      v -= row[i];
+
+    out[i] = v;
+  }
+}
+
+// Sum of clamp(input[i], 0, max) * weights[i] over the N entries. N must be
+// a multiple of 32. simdcheck passes every supported level explicitly
+template <std::size_t N>
+inline int crelu_dot(const int16_t *input, const int16_t *weights, int16_t max,
+                     Level kernel = level) {
+  static_assert(N % 32 == 0);
+
+#ifdef SIMD_X86
+  if (kernel == Level::AVX512)
+    return crelu_dot_avx512<N>(input, weights, max);
+
+  if (kernel == Level::AVX2)
+    return crelu_dot_avx2<N>(input, weights, max);
+#endif
+
+  return std::inner_product(input, input + N, weights, 0, std::plus{},
+                            [max](int16_t x, int16_t y) {
+                              return std::clamp<int>(x, 0, max) * y;
+                            });
+}
+} // namespace Simd
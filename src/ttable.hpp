@@ -2,39 +2,293 @@
 
 #include "eval.hpp"
 #include "move.hpp"
-#include <vector>
+#include "numa.hpp"
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <new>
+#include <print>
+#include <span>
+#include <thread>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
 
 struct TTNode {
   enum class Type : uint8_t { EXACT, LOWERBOUND, UPPERBOUND };
-  uint64_t hash;
   Move best_move;
-  short value, depth;
+  short value, static_eval, depth;
   Type type;
 };
 
-class TTable {
+// Each entry is a 64-bit data word plus a 16-bit key. The key is stored XOR-ed
+// with a fold of the data word, so an entry whose two halves come from
+// different writes reads as a miss, except for the 1 in 65536 whose folds
+// happen to agree. The parameters are
+// for ttstress only: without VERIFY the key is stored plain, and INTERLEAVE
+// yields between the two stores so that other threads see half-written
+// entries even on a single core
+template <bool VERIFY = true, bool INTERLEAVE = false> class BasicTTable {
+  static constexpr std::size_t CLUSTER_SIZE = 6;
+
+  // How much shallower than the stored entry a bound for the same position
+  // may be and still replace it
+  static constexpr int DEPTH_MARGIN = 4;
+
+  struct alignas(64) Cluster {
+    std::array<std::atomic<uint64_t>, CLUSTER_SIZE> data;
+    std::array<std::atomic<uint16_t>, CLUSTER_SIZE> keys;
+  };
+
+  static_assert(sizeof(Cluster) == 64);
+
+  // Precedes the clusters in saved tables. FORMAT_VERSION must be bumped
+  // whenever the entry layout changes
+  struct alignas(64) FileHeader {
+    static constexpr uint64_t MAGIC = 0x31544854414d4853, FORMAT_VERSION = 1;
+
+    uint64_t magic, version, size, net_hash;
+    uint8_t generation;
+  };
+
+  static_assert(sizeof(FileHeader) == sizeof(Cluster));
+
+  // Tables loaded from disk live in a private file mapping that starts with
+  // the header, everything else comes from aligned_alloc
+  struct Deleter {
+    std::size_t mapped_bytes;
+
+    void operator()(Cluster *clusters) const {
+#ifdef __linux__
+      if (mapped_bytes) {
+        munmap(reinterpret_cast<FileHeader *>(clusters) - 1, mapped_bytes);
+        return;
+      }
+#endif
+      std::free(clusters);
+    }
+  };
+
 public:
-  constexpr TTable() : size(1 << 22), table(size) {}
+  // Only records the size, the memory is allocated on isready or on the
+  // first search, whichever comes first. Zero gives a single cluster
+  void resize(std::size_t megabytes) {
+    this->megabytes = megabytes;
+    table.reset();
+  }
+
+  // Halves the size until the allocation succeeds rather than leaving the
+  // table null, and reports it when that happens
+  void allocate(std::size_t num_threads, const NumaTopology *numa = nullptr) {
+    if (table)
+      return;
+
+    static constexpr std::size_t HUGE_PAGE_SIZE = 1 << 21;
+
+    std::size_t requested = megabytes;
+    void *memory = nullptr;
+
+    for (;; megabytes /= 2) {
+      size = std::max<std::size_t>((megabytes << 20) / sizeof(Cluster), 1);
+
+      std::size_t bytes = size * sizeof(Cluster),
+                  huge_page_bytes = (bytes + HUGE_PAGE_SIZE - 1) /
+                                    HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+      memory = std::aligned_alloc(HUGE_PAGE_SIZE, huge_page_bytes);
+
+#ifdef MADV_HUGEPAGE
+      if (memory)
+        madvise(memory, huge_page_bytes, MADV_HUGEPAGE);
+#endif
+
+      if (!memory)
+        memory = std::aligned_alloc(alignof(Cluster), bytes);
+
+      if (memory)
+        break;
+
+      if (!megabytes)
+        throw std::bad_alloc();
+    }
+
+    if (megabytes != requested)
+      std::println("info string could not allocate {} MB of hash, using {} MB",
+                   requested, megabytes);
+
+    table = {static_cast<Cluster *>(memory), Deleter{}};
+    clear(num_threads, numa);
+  }
+
+  bool save(const std::filesystem::path &path, uint64_t net_hash) const {
+    if (!table)
+      return false;
+
+    // Zeroed as raw bytes, initialisation alone leaves the padding after the
+    // generation indeterminate
+    FileHeader header;
+    std::memset(&header, 0, sizeof(header));
+    header.magic = FileHeader::MAGIC;
+    header.version = FileHeader::FORMAT_VERSION;
+    header.size = size;
+    header.net_hash = net_hash;
+    header.generation = generation;
+
+    std::ofstream out(path, std::ios::binary);
+
+    out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char *>(table.get()),
+              size * sizeof(Cluster));
+
+    return bool(out);
+  }
+
+  // Maps a table written by save() copy-on-write, so probing it only pages
+  // in the parts that the search actually touches
+  bool load(const std::filesystem::path &path, uint64_t net_hash) {
+#ifdef __linux__
+    int fd = open(path.c_str(), O_RDONLY);
+
+    if (fd < 0)
+      return false;
+
+    FileHeader header{};
+    off_t end = lseek(fd, 0, SEEK_END);
+
+    if (end < 0) {
+      close(fd);
+      return false;
+    }
+
+    std::size_t file_size = end;
+
+    if (pread(fd, &header, sizeof(header), 0) != sizeof(header) ||
+        header.magic != FileHeader::MAGIC ||
+        header.version != FileHeader::FORMAT_VERSION ||
+        header.net_hash != net_hash || header.size == 0 ||
+        file_size != sizeof(header) + header.size * sizeof(Cluster)) {
+      close(fd);
+      return false;
+    }
+
+    void *memory =
+        mmap(nullptr, file_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (memory == MAP_FAILED)
+      return false;
+
+    size = header.size;
+    megabytes = (size * sizeof(Cluster)) >> 20;
+    generation = header.generation;
+    table = {reinterpret_cast<Cluster *>(static_cast<FileHeader *>(memory) + 1),
+             Deleter{file_size}};
 
-  constexpr void resize(std::size_t new_size) {
-    size = new_size;
-    table.resize(new_size);
+    return true;
+#else
+    return false;
+#endif
   }
 
-  constexpr void insert(uint64_t hash, Move best_move, short value, short depth,
-                        TTNode::Type flag, int ply) {
+  // Zeroes the table in place, split evenly across num_threads. Given a NUMA
+  // topology, the chunks are cleared from threads bound to alternating nodes
+  // so that first-touch placement interleaves the table across them
+  void clear(std::size_t num_threads, const NumaTopology *numa = nullptr) {
+    generation = 0;
+
+    if (!table)
+      return;
+
+    if (numa)
+      num_threads = std::max(num_threads, numa->num_nodes());
+
+    std::vector<std::jthread> threads;
+
+    for (std::size_t i = 0; i < num_threads; ++i)
+      threads.emplace_back([this, i, num_threads, numa]() {
+        if (numa)
+          numa->bind_thread(i % numa->num_nodes());
+
+        std::uninitialized_value_construct(
+            table.get() + size * i / num_threads,
+            table.get() + size * (i + 1) / num_threads);
+      });
+  }
+
+  // Called once per search so that entries from earlier searches are
+  // preferred for replacement and excluded from hashfull
+  void new_search() { generation = (generation + 1) & GENERATION_MASK; }
+
+  void insert(uint64_t hash, Move best_move, short value, short static_eval,
+              short depth, TTNode::Type flag, int ply) {
     if (value < -CHECKMATE_THRESHOLD)
       value -= ply;
     else if (value > CHECKMATE_THRESHOLD)
       value += ply;
 
-    table[hash % size] = {hash, best_move, value, depth, flag};
+    Cluster &cluster = table[index(hash)];
+    std::size_t replace = 0;
+    int replace_score = std::numeric_limits<int>::max();
+
+    for (std::size_t i = 0; i < CLUSTER_SIZE; ++i) {
+      uint64_t data = cluster.data[i].load(std::memory_order_relaxed);
+
+      if (!(data & VALID_BIT)) {
+        replace = i;
+        break;
+      }
+
+      // The same position searched again only replaces a deeper result from
+      // this search if it is exact, and a bound without a move keeps the move
+      // found before
+      if (matches(cluster, i, hash, data)) {
+        if (flag != TTNode::Type::EXACT && (data >> 59) == generation &&
+            depth + DEPTH_MARGIN < static_cast<int8_t>(data >> 48))
+          return;
+
+        if (best_move == Move())
+          best_move.data = data & 0xFFFF;
+
+        replace = i;
+        break;
+      }
+
+      int age = (generation - (data >> 59)) & GENERATION_MASK,
+          score = static_cast<int8_t>(data >> 48) - 8 * age;
+
+      if (score < replace_score) {
+        replace = i;
+        replace_score = score;
+      }
+    }
+
+    uint64_t data = pack(best_move, value, static_eval, depth, flag);
+
+    cluster.data[replace].store(data, std::memory_order_relaxed);
+
+    if constexpr (INTERLEAVE)
+      std::this_thread::yield();
+
+    cluster.keys[replace].store(static_cast<uint16_t>(hash) ^ fold(data),
+                                std::memory_order_relaxed);
   }
 
-  constexpr std::optional<TTNode> lookup(uint64_t hash, int ply) {
-    TTNode node = table[hash % size];
+  std::optional<TTNode> lookup(uint64_t hash, int ply) const {
+    const Cluster &cluster = table[index(hash)];
+
+    for (std::size_t i = 0; i < CLUSTER_SIZE; ++i) {
+      uint64_t data = cluster.data[i].load(std::memory_order_relaxed);
+
+      if (!(data & VALID_BIT) || !matches(cluster, i, hash, data))
+        continue;
+
+      TTNode node = unpack(data);
 
-    if (node.hash == hash) {
       if (node.value < -CHECKMATE_THRESHOLD)
         node.value += ply;
       else if (node.value > CHECKMATE_THRESHOLD)
@@ -46,12 +300,66 @@ public:
     return std::nullopt;
   }
 
-  constexpr int hashfull() const {
-    return std::count_if(table.begin(), table.begin() + 1000,
-                         [](const TTNode &node) { return node.hash != 0; });
+  void prefetch(uint64_t hash) const {
+    __builtin_prefetch(&table[index(hash)]);
+  }
+
+  int hashfull() const {
+    int count = 0;
+
+    for (const Cluster &cluster :
+         std::span(table.get(), std::min<std::size_t>(size, 1000)))
+      for (const auto &entry : cluster.data) {
+        uint64_t data = entry.load(std::memory_order_relaxed);
+        count += (data & VALID_BIT) && (data >> 59) == generation;
+      }
+
+    return count / CLUSTER_SIZE;
   }
 
 private:
-  std::size_t size;
-  std::vector<TTNode> table;
+  static constexpr uint64_t VALID_BIT = uint64_t(1) << 58;
+  static constexpr uint8_t GENERATION_MASK = 0x1F;
+
+  // Bits 0-15: move, 16-31: value, 32-47: static eval, 48-55: depth,
+  // 56-57: type, 58: valid, 59-63: generation
+  constexpr uint64_t pack(Move best_move, short value, short static_eval,
+                          short depth, TTNode::Type type) const {
+    return best_move.raw() | uint64_t(uint16_t(value)) << 16 |
+           uint64_t(uint16_t(static_eval)) << 32 |
+           uint64_t(uint8_t(std::min<short>(depth, MAX_DEPTH))) << 48 |
+           uint64_t(type) << 56 | VALID_BIT | uint64_t(generation) << 59;
+  }
+
+  static constexpr TTNode unpack(uint64_t data) {
+    Move best_move;
+    best_move.data = data & 0xFFFF;
+
+    return {best_move, static_cast<short>(data >> 16),
+            static_cast<short>(data >> 32), static_cast<int8_t>(data >> 48),
+            static_cast<TTNode::Type>((data >> 56) & 0b11)};
+  }
+
+  static constexpr uint16_t fold(uint64_t data) {
+    if constexpr (!VERIFY)
+      return 0;
+
+    return data ^ (data >> 16) ^ (data >> 32) ^ (data >> 48);
+  }
+
+  static bool matches(const Cluster &cluster, std::size_t i, uint64_t hash,
+                      uint64_t data) {
+    return (cluster.keys[i].load(std::memory_order_relaxed) ^ fold(data)) ==
+           static_cast<uint16_t>(hash);
+  }
+
+  constexpr std::size_t index(uint64_t hash) const {
+    return (static_cast<unsigned __int128>(hash) * size) >> 64;
+  }
+
+  std::size_t megabytes = 64, size;
+  std::unique_ptr<Cluster[], Deleter> table;
+  uint8_t generation = 0;
 };
+
+using TTable = BasicTTable<>;
@@ -16,5 +16,6 @@ inline constexpr double ASP_MULTIPLIER = 2;
 inline constexpr int64_t DATAGEN_SOFT_NODE_LIMIT = 5000;
 inline constexpr int64_t DATAGEN_HARD_NODE_LIMIT =
     DATAGEN_SOFT_NODE_LIMIT * 100;
+inline constexpr int BENCH_DEPTH = 10;
 inline constexpr const char *NET_PATH = "nnue.bin";
 inline constexpr int HL = 128, SCALE = 400, QA = 255, QB = 64;
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "bench.hpp"
 #include "datagen.hpp"
 #include "perft.hpp"
 #include "searcher.hpp"
@@ -28,10 +29,18 @@ public:
     using std::literals::string_literals::operator""s;
     std::vector<std::string_view> tokens = string_tokenizer(command);
 
+    // Everything but stop and isready changes state that a running search
+    // reads, so it waits for the search to finish first
+    if (tokens[0] != "stop" && tokens[0] != "isready" &&
+        searcher_future.valid())
+      searcher_future.wait();
+
     if (tokens[0] == "uci")
       std::puts("id name Sah Matt\n"
                 "id author Matei Hriscu\n"
                 "option name Hash type spin default 64 min 1 max 16384\n"
+                "option name Threads type spin default 1 min 1 max 1024\n"
+                "option name NumaBind type check default false\n"
                 "uciok");
     else if (tokens[0] == "setoption") {
       auto value_it = std::ranges::find(tokens, "value");
@@ -40,11 +49,15 @@ public:
                   value = join_tokens(std::span{value_it + 1, tokens.end()});
 
       if (name == "Hash")
-        searcher.resize_ttable(parse_number<size_t>(value) * (1 << 20) /
-                               sizeof(TTNode));
-    } else if (tokens[0] == "isready")
+        searcher.resize_ttable(parse_number<size_t>(value));
+      else if (name == "Threads")
+        searcher.set_threads(parse_number<size_t>(value));
+      else if (name == "NumaBind")
+        searcher.set_numa_bind(value == "true");
+    } else if (tokens[0] == "isready") {
+      searcher.allocate_ttable();
       std::puts("readyok");
-    else if (tokens[0].starts_with("position")) {
+    } else if (tokens[0].starts_with("position")) {
       position = NetBoard(
           tokens[1] == "startpos"
               ? std::string(STARTPOS)
@@ -59,7 +72,7 @@ public:
            std::views::drop_while(tokens, [](std::string_view token) {
              return token != "moves";
            }) | std::views::drop(1)) {
-        position.make_move(position.pseudolegal_moves().get_matching_move(
+        position.make_move(position.legal_moves().get_matching_move(
             move_str.substr(0, 2), move_str.substr(2, 2),
             move_str.size() == 5 ? Piece(move_str.back()) : Piece()));
         searcher.add_hash(position.zobrist);
@@ -97,10 +110,31 @@ public:
       searcher.stop();
     else if (tokens[0] == "ucinewgame")
       searcher.clear();
-    else if (tokens[0] == "perft")
-      std::println("{}", perft(position, parse_number<int>(tokens[1])));
-    else if (tokens[0] == "splitperft")
+    else if (tokens[0] == "savehash") {
+      if (!searcher.save_ttable(tokens[1], position.net.get().hash()))
+        std::println("info string could not save hash to {}", tokens[1]);
+    } else if (tokens[0] == "loadhash") {
+      if (!searcher.load_ttable(tokens[1], position.net.get().hash()))
+        std::println("info string could not load hash from {}", tokens[1]);
+    } else if (tokens[0] == "perft") {
+      Board board = position;
+      std::println("{}", perft(board, parse_number<int>(tokens[1])));
+    } else if (tokens[0] == "splitperft")
       splitperft(position, parse_number<int>(tokens[1]));
+    else if (tokens[0] == "bench")
+      bench(searcher,
+            tokens.size() > 1 ? parse_number<int>(tokens[1]) : BENCH_DEPTH,
+            position.net);
+    else if (tokens[0] == "sliderbench")
+      slider_bench(tokens.size() > 1 ? parse_number<int64_t>(tokens[1])
+                                     : 100'000'000);
+    else if (tokens[0] == "simdcheck")
+      simd_check(position.net,
+                 tokens.size() > 1 ? parse_number<int>(tokens[1]) : 16);
+    else if (tokens[0] == "ttstress")
+      tt_stress(tokens.size() > 1 ? parse_number<int>(tokens[1]) : 4,
+                tokens.size() > 2 ? parse_number<int64_t>(tokens[2])
+                                  : 1'000'000);
     else if (tokens[0] == "print")
       std::println("{}", static_cast<Board>(position));
     else if (tokens[0] == "datagen")
@@ -114,8 +148,10 @@ public:
     while (true) {
       getline(std::cin, command);
 
-      if (command == "quit")
+      if (command == "quit") {
+        searcher.stop();
         break;
+      }
 
       process_command(command);
     }